@@ -4,6 +4,9 @@
 #include "llvm_builder.h"
 #include "llvm_module.h"
 #include "llvm_types.h"
+#include "llvm_jit.h"
+#include "llvm_target_machine.h"
+#include "llvm_linker.h"
 #include "llvm_builder.h"
 #include <iostream>
 namespace llvm_nodejs {
@@ -39,6 +42,14 @@ Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
     std::cout << "Initialized LLVM Basic Block" << std::endl;
     exports = PHINodeWrapper::Init(env, exports);
     std::cout << "Initialized LLVM PHINode" << std::endl;
+    exports = JITEngineWrapper::Init(env, exports);
+    std::cout << "Initialized LLVM JIT Engine" << std::endl;
+    exports = JITModuleWrapper::Init(env, exports);
+    std::cout << "Initialized LLVM JIT Module" << std::endl;
+    exports = TargetMachineWrapper::Init(env, exports);
+    std::cout << "Initialized LLVM Target Machine" << std::endl;
+    exports = BitcodeLibraryWrapper::Init(env, exports);
+    std::cout << "Initialized LLVM Bitcode Library" << std::endl;
 
     return exports;
 }
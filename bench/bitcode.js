@@ -0,0 +1,94 @@
+// Size and round-trip time of bitcode (toBitcode/parseBitcode) against
+// textual IR (dump/parseIR). Pass a .ll or .bc file to measure one of our
+// own modules; otherwise a synthetic module is generated.
+//
+//   node bench/bitcode.js [module.ll | module.bc] [iterations]
+import { createRequire } from 'module';
+const require = createRequire(import.meta.url);
+const fs = require('fs');
+
+const llvm = require('../build/Release/llvm_nodejs');
+
+const input = process.argv[2] && isNaN(Number(process.argv[2])) ? process.argv[2] : null;
+const iterations = Number(process.argv[input ? 3 : 2] || 20);
+
+// i32 sum_<i>(i32* values, i32 length) loops adding *values; calls to the
+// previous function keep every function referenced
+function buildModule(context, functionCount) {
+    const int32Type = context.getInt32Ty();
+    const int32PtrType = llvm.PointerType.get(int32Type, 0);
+    const sumType = llvm.FunctionType.get(int32Type, [int32PtrType, int32Type], false);
+    const module = context.createModule('bitcode_bench');
+    const builder = new llvm.IRBuilder(context);
+
+    let previous = null;
+    for (let i = 0; i < functionCount; i++) {
+        const fn = module.createFunction(`sum_${i}`, sumType);
+        const entry = fn.createBasicBlock('entry');
+        const loop = fn.createBasicBlock('loop');
+        const exit = fn.createBasicBlock('exit');
+        const values = fn.getArgument(0);
+        const length = fn.getArgument(1);
+
+        builder.setInsertPoint(entry);
+        const start = previous ? builder.createCall(previous, [values, length]) : length;
+        builder.createBr(loop);
+
+        builder.setInsertPoint(loop);
+        const index = builder.createPHI(int32Type, 2);
+        const total = builder.createPHI(int32Type, 2);
+        const element = builder.createLoad(int32Type, values);
+        const nextTotal = builder.createAdd(total, element);
+        const nextIndex = builder.createAdd(index, length);
+        index.addIncoming(start, entry);
+        index.addIncoming(nextIndex, loop);
+        total.addIncoming(start, entry);
+        total.addIncoming(nextTotal, loop);
+        builder.createCondBr(builder.createICmpSLT(nextIndex, length), loop, exit);
+
+        builder.setInsertPoint(exit);
+        builder.createRet(nextTotal);
+        previous = fn;
+    }
+    return module;
+}
+
+function loadModule(context, path) {
+    const data = fs.readFileSync(path);
+    // Bitcode files start with 'BC' 0xC0DE
+    const isBitcode = data.length >= 4 && data.readUInt32LE(0) === 0xdec04342;
+    return isBitcode ? context.parseBitcode(data) : context.parseIR(data);
+}
+
+function measure(fn) {
+    fn();
+    const start = process.hrtime.bigint();
+    for (let i = 0; i < iterations; i++) fn();
+    return Number(process.hrtime.bigint() - start) / 1e6 / iterations;
+}
+
+const context = new llvm.LLVMContext();
+const module = input ? loadModule(context, input) : buildModule(context, 2000);
+
+const text = module.dump();
+const bitcode = module.toBitcode();
+const textBytes = Buffer.byteLength(text);
+
+const results = [
+    ['text (dump/parseIR)', textBytes, measure(() => module.dump()), measure(() => context.parseIR(text))],
+    ['bitcode (toBitcode/parseBitcode)', bitcode.length, measure(() => module.toBitcode()),
+        measure(() => context.parseBitcode(bitcode))],
+];
+
+console.log(`${input || 'synthetic module'}, ${iterations} iterations`);
+console.log(`${'format'.padEnd(34)} ${'bytes'.padStart(10)} ${'write ms'.padStart(10)} ` +
+    `${'read ms'.padStart(10)} ${'total ms'.padStart(10)}`);
+for (const [label, bytes, write, read] of results) {
+    console.log(`${label.padEnd(34)} ${String(bytes).padStart(10)} ${write.toFixed(2).padStart(10)} ` +
+        `${read.toFixed(2).padStart(10)} ${(write + read).toFixed(2).padStart(10)}`);
+}
+
+const [, , textWrite, textRead] = results[0];
+const [, , bitcodeWrite, bitcodeRead] = results[1];
+console.log(`bitcode is ${(textBytes / bitcode.length).toFixed(2)}x smaller, round trip ` +
+    `${((textWrite + textRead) / (bitcodeWrite + bitcodeRead)).toFixed(2)}x faster`);
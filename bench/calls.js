@@ -0,0 +1,86 @@
+// Calls per second of JIT functions bound through the generic slot wrapper
+// and through signature-specialized trampolines.
+//
+//   node bench/calls.js [iterations]
+import { createRequire } from 'module';
+const require = createRequire(import.meta.url);
+
+const llvm = require('../build/Release/llvm_nodejs');
+
+const iterations = Number(process.argv[2] || 5_000_000);
+
+function buildModule() {
+    const context = new llvm.LLVMContext();
+    const int32Type = context.getInt32Ty();
+    const module = context.createModule('calls_bench');
+    const builder = new llvm.IRBuilder(context);
+
+    // i32 max(i32, i32)
+    const maxType = llvm.FunctionType.get(int32Type, [int32Type, int32Type], false);
+    const maxFunction = module.createFunction('max', maxType);
+    const entry = maxFunction.createBasicBlock('entry');
+    const thenBlock = maxFunction.createBasicBlock('then');
+    const elseBlock = maxFunction.createBasicBlock('else');
+    const returnBlock = maxFunction.createBasicBlock('return');
+    const a = maxFunction.getArgument(0);
+    const b = maxFunction.getArgument(1);
+    builder.setInsertPoint(entry);
+    builder.createCondBr(builder.createICmpSGT(a, b), thenBlock, elseBlock);
+    builder.setInsertPoint(thenBlock);
+    builder.createBr(returnBlock);
+    builder.setInsertPoint(elseBlock);
+    builder.createBr(returnBlock);
+    builder.setInsertPoint(returnBlock);
+    const phi = builder.createPHI(int32Type, 2);
+    phi.addIncoming(a, thenBlock);
+    phi.addIncoming(b, elseBlock);
+    builder.createRet(phi);
+
+    // i32 head(i32* values, i32 length): first element plus the length
+    const int32PtrType = llvm.PointerType.get(int32Type, 0);
+    const headType = llvm.FunctionType.get(int32Type, [int32PtrType, int32Type], false);
+    const headFunction = module.createFunction('head', headType);
+    builder.setInsertPoint(headFunction.createBasicBlock('entry'));
+    const first = builder.createLoad(int32Type, headFunction.getArgument(0));
+    builder.createRet(builder.createAdd(first, headFunction.getArgument(1)));
+
+    return module;
+}
+
+function measure(label, fn) {
+    // Warm up so that V8 has optimized the loop before it is timed
+    fn(Math.min(iterations, 100_000));
+    const start = process.hrtime.bigint();
+    fn(iterations);
+    const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+    const rate = iterations / seconds;
+    console.log(`${label.padEnd(32)} ${(rate / 1e6).toFixed(2).padStart(8)} M calls/s`);
+    return rate;
+}
+
+const jit = new llvm.JITEngine();
+jit.addModule(buildModule());
+
+const maxGeneric = jit.getFunction('max', { specialize: false });
+const maxSpecialized = jit.getFunction('max');
+const headGeneric = jit.getFunction('head', { lengthArgs: true, specialize: false });
+const headSpecialized = jit.getFunction('head', { lengthArgs: true });
+
+const values = new Int32Array([7, 8, 9]);
+let sink = 0;
+
+const maxGenericRate = measure('max(i32,i32) generic', (n) => {
+    for (let i = 0; i < n; i++) sink += maxGeneric(i, 1000);
+});
+const maxSpecializedRate = measure('max(i32,i32) specialized', (n) => {
+    for (let i = 0; i < n; i++) sink += maxSpecialized(i, 1000);
+});
+const headGenericRate = measure('head(i32*,len) generic', (n) => {
+    for (let i = 0; i < n; i++) sink += headGeneric(values);
+});
+const headSpecializedRate = measure('head(i32*,len) specialized', (n) => {
+    for (let i = 0; i < n; i++) sink += headSpecialized(values);
+});
+
+console.log(`speedup: max ${(maxSpecializedRate / maxGenericRate).toFixed(2)}x, ` +
+    `head ${(headSpecializedRate / headGenericRate).toFixed(2)}x (checksum ${sink})`);
@@ -8,6 +8,17 @@
         "llvm_types.cpp",
         "llvm_builder.cpp",
         "llvm_function.cpp",
+        "llvm_jit.cpp",
+        "llvm_passes.cpp",
+        "llvm_target.cpp",
+        "llvm_target_machine.cpp",
+        "llvm_attributes.cpp",
+        "llvm_loop_hints.cpp",
+        "llvm_profile.cpp",
+        "llvm_linker.cpp",
+        "llvm_print.cpp",
+        "llvm_async.cpp",
+        "llvm_cache.cpp",
         "addon.cpp"
       ],
       "include_dirs": [
@@ -18,7 +29,7 @@
         "<!(node -p \"require('node-addon-api').gyp\")"
       ],
       "libraries": [
-        "<!@(llvm-config --ldflags --libs core orcjit native)"
+        "<!@(llvm-config --ldflags --libs core orcjit native passes asmparser bitreader bitwriter linker profiledata)"
       ],
       "cflags": [
         "<!@(llvm-config --cflags)"
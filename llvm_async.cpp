@@ -0,0 +1,188 @@
+#include "llvm_async.h"
+#include "llvm_module.h"
+#include "llvm_target.h"
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <mutex>
+#include <set>
+
+namespace llvm_nodejs {
+
+// Contexts with a job in flight. Worker threads of the same process share
+// the set, although in practice every context belongs to one JS thread.
+static std::mutex lockedContextsMutex;
+static std::set<const llvm::LLVMContext*> lockedContexts;
+
+bool IsContextLocked(const llvm::LLVMContext& context) {
+    std::lock_guard<std::mutex> lock(lockedContextsMutex);
+    return lockedContexts.count(&context) > 0;
+}
+
+bool CheckContextUnlocked(Napi::Env env, const llvm::LLVMContext& context) {
+    if (IsContextLocked(context)) {
+        Napi::Error::New(env, "LLVMContext is locked by a pending async operation")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+//
+// ModuleJob implementation
+//
+ModuleJob::ModuleJob(Napi::Env env, Napi::Object owner, llvm::orc::ThreadSafeContext context,
+                     llvm::Module* module)
+    : Napi::AsyncWorker(env), context_(std::move(context)), module_(module),
+      deferred_(Napi::Promise::Deferred::New(env)), owner_(Napi::Persistent(owner)),
+      locked_(true) {
+    std::lock_guard<std::mutex> lock(lockedContextsMutex);
+    lockedContexts.insert(context_.getContext());
+}
+
+ModuleJob::~ModuleJob() {
+    Unlock();
+}
+
+void ModuleJob::Unlock() {
+    if (locked_) {
+        std::lock_guard<std::mutex> lock(lockedContextsMutex);
+        lockedContexts.erase(context_.getContext());
+        locked_ = false;
+    }
+}
+
+void ModuleJob::Execute() {
+    auto lock = context_.getLock();
+    Run();
+}
+
+void ModuleJob::OnOK() {
+    // Unlock first so that continuations may use the module again
+    Unlock();
+    deferred_.Resolve(Result(Env()));
+}
+
+void ModuleJob::OnError(const Napi::Error& error) {
+    Unlock();
+    deferred_.Reject(error.Value());
+}
+
+//
+// VerifyJob implementation
+//
+void VerifyJob::Run() {
+    llvm::raw_string_ostream errorStream(error_);
+    valid_ = !llvm::verifyModule(*module_, &errorStream);
+    errorStream.flush();
+}
+
+Napi::Value VerifyJob::Result(Napi::Env env) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("valid", Napi::Boolean::New(env, valid_));
+    if (!valid_) {
+        result.Set("error", Napi::String::New(env, error_));
+    }
+    return result;
+}
+
+//
+// OptimizeJob implementation
+//
+void OptimizeJob::Run() {
+    // The target machine only feeds cost models, so optimize without one if
+    // the module targets something we cannot create
+    auto targetMachine = target_ ? CreateTargetMachine(*target_) : CreateTargetMachineForModule(*module_);
+    if (!targetMachine) {
+        llvm::consumeError(targetMachine.takeError());
+        OptimizeModule(*module_, options_);
+        return;
+    }
+    OptimizeModule(*module_, options_, targetMachine->get());
+}
+
+//
+// EmitObjectJob implementation
+//
+void EmitObjectJob::Run() {
+    TargetMachineOptions options = target_ ? *target_ : TargetOptionsForModule(*module_);
+    std::unique_ptr<llvm::Module> copy = llvm::CloneModule(*module_);
+    if (llvm::Error err = EmitModuleSplit(*copy, options, fileType_, threads_, outputs_)) {
+        SetError(llvm::toString(std::move(err)));
+    }
+}
+
+Napi::Value EmitObjectJob::Result(Napi::Env env) {
+    if (threads_ <= 1) {
+        return Napi::Buffer<char>::Copy(env, outputs_[0].data(), outputs_[0].size());
+    }
+    Napi::Array parts = Napi::Array::New(env, outputs_.size());
+    for (size_t i = 0; i < outputs_.size(); i++) {
+        parts.Set(static_cast<uint32_t>(i), Napi::Buffer<char>::Copy(env, outputs_[i].data(), outputs_[i].size()));
+    }
+    return parts;
+}
+
+//
+// CompileJob implementation
+//
+CompileJob::CompileJob(Napi::Env env, Napi::Object owner, std::shared_ptr<JITEngine> engine,
+                       llvm::orc::ThreadSafeModule module)
+    : ModuleJob(env, owner, module.getContext(), module.getModuleUnlocked()),
+      engine_(std::move(engine)), threadSafeModule_(std::move(module)) {
+    for (llvm::Function& function : *module_) {
+        if (!function.isDeclaration() && !function.hasLocalLinkage()) {
+            names_.push_back(function.getName().str());
+        }
+    }
+}
+
+void CompileJob::Execute() {
+    std::string errorStr;
+    bool valid = threadSafeModule_.withModuleDo([&errorStr](llvm::Module& module) {
+        llvm::raw_string_ostream errorStream(errorStr);
+        return !llvm::verifyModule(module, &errorStream);
+    });
+    if (!valid) {
+        SetError("Module verification failed: " + errorStr);
+        return;
+    }
+
+    auto compiled = engine_->AddModule(std::move(threadSafeModule_));
+    if (!compiled) {
+        SetError(llvm::toString(compiled.takeError()));
+        return;
+    }
+    compiled_ = std::move(*compiled);
+    if (llvm::Error err = engine_->Materialize(names_)) {
+        SetError(llvm::toString(std::move(err)));
+    }
+}
+
+void CompileJob::OnError(const Napi::Error& error) {
+    // Still here if verification failed; the engine consumes it otherwise
+    if (threadSafeModule_) {
+        Napi::ObjectWrap<ModuleWrapper>::Unwrap(Owner())->ReturnModule(std::move(threadSafeModule_));
+    }
+    ModuleJob::OnError(error);
+}
+
+Napi::Value CompileJob::Result(Napi::Env env) {
+    return JITModuleWrapper::Create(env, engine_, compiled_);
+}
+
+//
+// RedefineJob implementation
+//
+RedefineJob::RedefineJob(Napi::Env env, Napi::Object owner, std::shared_ptr<JITEngine> engine,
+                         const std::string& name, llvm::orc::ThreadSafeModule module)
+    : ModuleJob(env, owner, module.getContext(), module.getModuleUnlocked()),
+      engine_(std::move(engine)), name_(name), threadSafeModule_(std::move(module)) {}
+
+void RedefineJob::Execute() {
+    if (llvm::Error err = engine_->Redefine(name_, std::move(threadSafeModule_))) {
+        SetError(llvm::toString(std::move(err)));
+    }
+}
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <napi.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include "llvm_jit.h"
+#include "llvm_passes.h"
+#include "llvm_target.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm_nodejs {
+
+// LLVMContext is not thread safe. While an async job works on IR of a
+// context, the context is locked and JS entry points that read or change IR
+// in it throw instead of racing with the job.
+bool IsContextLocked(const llvm::LLVMContext& context);
+
+// Throws and returns false if an async job holds the context
+bool CheckContextUnlocked(Napi::Env env, const llvm::LLVMContext& context);
+
+// Base class of the Promise-returning module operations. The job runs on the
+// libuv thread pool and keeps the JS module object alive until it settles.
+class ModuleJob : public Napi::AsyncWorker {
+public:
+    Napi::Promise GetPromise() const { return deferred_.Promise(); }
+
+protected:
+    ModuleJob(Napi::Env env, Napi::Object owner, llvm::orc::ThreadSafeContext context,
+              llvm::Module* module);
+    ~ModuleJob() override;
+
+    // Calls Run with the ThreadSafeContext lock held
+    void Execute() override;
+    void OnOK() override;
+    void OnError(const Napi::Error& error) override;
+
+    Napi::Object Owner() const { return owner_.Value(); }
+
+    // Worker thread part of the job; reports failures through SetError
+    virtual void Run() {}
+    // Value the Promise resolves to, created on the JS thread
+    virtual Napi::Value Result(Napi::Env env) { return env.Undefined(); }
+
+    llvm::orc::ThreadSafeContext context_;
+    llvm::Module* module_;
+
+private:
+    void Unlock();
+
+    Napi::Promise::Deferred deferred_;
+    Napi::ObjectReference owner_;
+    bool locked_;
+};
+
+class VerifyJob : public ModuleJob {
+public:
+    VerifyJob(Napi::Env env, Napi::Object owner, llvm::orc::ThreadSafeContext context,
+              llvm::Module* module)
+        : ModuleJob(env, owner, std::move(context), module), valid_(false) {}
+
+protected:
+    void Run() override;
+    Napi::Value Result(Napi::Env env) override;
+
+private:
+    bool valid_;
+    std::string error_;
+};
+
+class OptimizeJob : public ModuleJob {
+public:
+    OptimizeJob(Napi::Env env, Napi::Object owner, llvm::orc::ThreadSafeContext context,
+                llvm::Module* module, const OptimizationOptions& options,
+                std::shared_ptr<const TargetMachineOptions> target)
+        : ModuleJob(env, owner, std::move(context), module), options_(options), target_(std::move(target)) {}
+
+protected:
+    void Run() override;
+
+private:
+    OptimizationOptions options_;
+    std::shared_ptr<const TargetMachineOptions> target_;
+};
+
+// Code generation lowers IR in place, so the job works on a copy and the
+// module is left untouched. With more than one thread the copy is split and
+// the job resolves to one Buffer per part instead of a single Buffer.
+class EmitObjectJob : public ModuleJob {
+public:
+    EmitObjectJob(Napi::Env env, Napi::Object owner, llvm::orc::ThreadSafeContext context,
+                  llvm::Module* module, std::shared_ptr<const TargetMachineOptions> target,
+                  llvm::CodeGenFileType fileType = llvm::CGFT_ObjectFile, unsigned threads = 1)
+        : ModuleJob(env, owner, std::move(context), module), target_(std::move(target)),
+          fileType_(fileType), threads_(threads) {}
+
+protected:
+    void Run() override;
+    Napi::Value Result(Napi::Env env) override;
+
+private:
+    std::shared_ptr<const TargetMachineOptions> target_;
+    llvm::CodeGenFileType fileType_;
+    unsigned threads_;
+    std::vector<llvm::SmallVector<char, 0>> outputs_;
+};
+
+// Hands the module to a JIT engine and compiles its definitions, so that
+// getFunction afterwards only has to look them up. The module is taken right
+// away; if it fails to verify, it is given back before the Promise rejects,
+// as addModule leaves invalid IR with the caller. Resolves to the JITModule
+// handle of the compiled code.
+class CompileJob : public ModuleJob {
+public:
+    CompileJob(Napi::Env env, Napi::Object owner, std::shared_ptr<JITEngine> engine,
+               llvm::orc::ThreadSafeModule module);
+
+protected:
+    // Compilation may happen on other threads that need the context lock,
+    // so only verification runs with the lock held
+    void Execute() override;
+    void OnError(const Napi::Error& error) override;
+    Napi::Value Result(Napi::Env env) override;
+
+private:
+    std::shared_ptr<JITEngine> engine_;
+    llvm::orc::ThreadSafeModule threadSafeModule_;
+    std::shared_ptr<JITModuleState> compiled_;
+    std::vector<std::string> names_;
+};
+
+// Compiles a new body for a function of a JIT engine off the JS thread and
+// swaps it in. Resolves once calls reach the new body.
+class RedefineJob : public ModuleJob {
+public:
+    RedefineJob(Napi::Env env, Napi::Object owner, std::shared_ptr<JITEngine> engine,
+                const std::string& name, llvm::orc::ThreadSafeModule module);
+
+protected:
+    // Like CompileJob, without holding the context lock while compiling
+    void Execute() override;
+
+private:
+    std::shared_ptr<JITEngine> engine_;
+    std::string name_;
+    llvm::orc::ThreadSafeModule threadSafeModule_;
+};
+
+}  // namespace llvm_nodejs
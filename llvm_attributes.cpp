@@ -0,0 +1,193 @@
+#include "llvm_attributes.h"
+#include "llvm_types.h"
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+
+namespace llvm_nodejs {
+
+static const char* PositionName(unsigned index) {
+    if (index == llvm::AttributeList::FunctionIndex) {
+        return "functions";
+    }
+    return index == llvm::AttributeList::ReturnIndex ? "return values" : "parameters";
+}
+
+static bool ReadAttributeName(const Napi::CallbackInfo& info, size_t argIndex, std::string& name) {
+    if (info.Length() <= argIndex || !info[argIndex].IsString()) {
+        Napi::TypeError::New(info.Env(), "Attribute name expected").ThrowAsJavaScriptException();
+        return false;
+    }
+    name = info[argIndex].As<Napi::String>().Utf8Value();
+    return true;
+}
+
+bool AddAttribute(const Napi::CallbackInfo& info, size_t argIndex, llvm::LLVMContext& context,
+                  llvm::AttributeList& attributes, unsigned index, llvm::Type* valueType) {
+    Napi::Env env = info.Env();
+    std::string name;
+    if (!ReadAttributeName(info, argIndex, name)) {
+        return false;
+    }
+    Napi::Value value = info.Length() > argIndex + 1 ? info[argIndex + 1] : env.Undefined();
+
+    llvm::Attribute::AttrKind kind = llvm::Attribute::getAttrKindFromName(name);
+    if (kind == llvm::Attribute::None) {
+        if (!value.IsUndefined() && !value.IsString()) {
+            Napi::TypeError::New(env, "String attribute '" + name + "' takes a string value")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        std::string text = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+        attributes = attributes.addAttributeAtIndex(context, index, name, text);
+        return true;
+    }
+
+    bool usable = index == llvm::AttributeList::FunctionIndex ? llvm::Attribute::canUseAsFnAttr(kind)
+                : index == llvm::AttributeList::ReturnIndex ? llvm::Attribute::canUseAsRetAttr(kind)
+                : llvm::Attribute::canUseAsParamAttr(kind);
+    if (!usable) {
+        Napi::TypeError::New(env, "Attribute '" + name + "' does not apply to " + PositionName(index))
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    if (valueType && llvm::AttributeFuncs::typeIncompatible(valueType).contains(kind)) {
+        std::string typeName;
+        llvm::raw_string_ostream stream(typeName);
+        valueType->print(stream);
+        Napi::TypeError::New(env, "Attribute '" + name + "' does not apply to type " + stream.str())
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    llvm::Attribute attribute;
+    if (llvm::Attribute::isIntAttrKind(kind)) {
+        if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 1) {
+            Napi::TypeError::New(env, "Attribute '" + name + "' takes a positive number")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        uint64_t number = static_cast<uint64_t>(value.As<Napi::Number>().Int64Value());
+        if ((kind == llvm::Attribute::Alignment || kind == llvm::Attribute::StackAlignment) &&
+            !llvm::isPowerOf2_64(number)) {
+            Napi::RangeError::New(env, "Alignment must be a power of 2").ThrowAsJavaScriptException();
+            return false;
+        }
+        attribute = llvm::Attribute::get(context, kind, number);
+    } else if (llvm::Attribute::isTypeAttrKind(kind)) {
+        if (!value.IsObject() || !TypeWrapper::IsInstance(value.As<Napi::Object>())) {
+            Napi::TypeError::New(env, "Attribute '" + name + "' takes a Type").ThrowAsJavaScriptException();
+            return false;
+        }
+        attribute = llvm::Attribute::get(context, kind,
+                                         Napi::ObjectWrap<TypeWrapper>::Unwrap(value.As<Napi::Object>())->GetType());
+    } else {
+        if (!value.IsUndefined()) {
+            Napi::TypeError::New(env, "Attribute '" + name + "' takes no value").ThrowAsJavaScriptException();
+            return false;
+        }
+        attribute = llvm::Attribute::get(context, kind);
+    }
+
+    attributes = attributes.addAttributeAtIndex(context, index, attribute);
+    return true;
+}
+
+bool RemoveAttribute(const Napi::CallbackInfo& info, size_t argIndex, llvm::LLVMContext& context,
+                     llvm::AttributeList& attributes, unsigned index) {
+    std::string name;
+    if (!ReadAttributeName(info, argIndex, name)) {
+        return false;
+    }
+    llvm::Attribute::AttrKind kind = llvm::Attribute::getAttrKindFromName(name);
+    attributes = kind == llvm::Attribute::None ? attributes.removeAttributeAtIndex(context, index, name)
+                                               : attributes.removeAttributeAtIndex(context, index, kind);
+    return true;
+}
+
+bool HasAttribute(const Napi::CallbackInfo& info, size_t argIndex, const llvm::AttributeList& attributes,
+                  unsigned index, bool& result) {
+    std::string name;
+    if (!ReadAttributeName(info, argIndex, name)) {
+        return false;
+    }
+    llvm::Attribute::AttrKind kind = llvm::Attribute::getAttrKindFromName(name);
+    result = kind == llvm::Attribute::None ? attributes.hasAttributeAtIndex(index, name)
+                                           : attributes.hasAttributeAtIndex(index, kind);
+    return true;
+}
+
+bool SetMemoryEffects(const Napi::CallbackInfo& info, size_t argIndex, llvm::LLVMContext& context,
+                      llvm::AttributeList& attributes) {
+    Napi::Env env = info.Env();
+    if (info.Length() <= argIndex || !info[argIndex].IsString()) {
+        Napi::TypeError::New(env, "Memory access ('none', 'read', 'write' or 'readwrite') expected")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    std::string access = info[argIndex].As<Napi::String>().Utf8Value();
+    llvm::Attribute::AttrKind accessKind;
+    if (access == "none") {
+        accessKind = llvm::Attribute::ReadNone;
+    } else if (access == "read") {
+        accessKind = llvm::Attribute::ReadOnly;
+    } else if (access == "write") {
+        accessKind = llvm::Attribute::WriteOnly;
+    } else if (access == "readwrite") {
+        accessKind = llvm::Attribute::None;
+    } else {
+        Napi::RangeError::New(env, "Memory access must be 'none', 'read', 'write' or 'readwrite'")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    std::string location = "any";
+    if (info.Length() > argIndex + 1 && info[argIndex + 1].IsString()) {
+        location = info[argIndex + 1].As<Napi::String>().Utf8Value();
+    }
+    llvm::Attribute::AttrKind locationKind;
+    if (location == "any") {
+        locationKind = llvm::Attribute::None;
+    } else if (location == "argmem") {
+        locationKind = llvm::Attribute::ArgMemOnly;
+    } else if (location == "inaccessiblemem") {
+        locationKind = llvm::Attribute::InaccessibleMemOnly;
+    } else if (location == "inaccessiblemem-or-argmem") {
+        locationKind = llvm::Attribute::InaccessibleMemOrArgMemOnly;
+    } else {
+        Napi::RangeError::New(env, "Memory location must be 'any', 'argmem', 'inaccessiblemem' or "
+                                   "'inaccessiblemem-or-argmem'").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    const llvm::Attribute::AttrKind memoryKinds[] = {
+        llvm::Attribute::ReadNone, llvm::Attribute::ReadOnly, llvm::Attribute::WriteOnly,
+        llvm::Attribute::ArgMemOnly, llvm::Attribute::InaccessibleMemOnly,
+        llvm::Attribute::InaccessibleMemOrArgMemOnly,
+    };
+    for (llvm::Attribute::AttrKind kind : memoryKinds) {
+        attributes = attributes.removeFnAttribute(context, kind);
+    }
+    if (accessKind != llvm::Attribute::None) {
+        attributes = attributes.addFnAttribute(context, accessKind);
+    }
+    if (locationKind != llvm::Attribute::None && accessKind != llvm::Attribute::ReadNone) {
+        attributes = attributes.addFnAttribute(context, locationKind);
+    }
+    return true;
+}
+
+Napi::Object DescribeAttributes(Napi::Env env, const llvm::AttributeList& attributes, unsigned paramCount) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("function", Napi::String::New(env, attributes.getFnAttrs().getAsString()));
+    result.Set("return", Napi::String::New(env, attributes.getRetAttrs().getAsString()));
+    Napi::Array params = Napi::Array::New(env, paramCount);
+    for (unsigned i = 0; i < paramCount; i++) {
+        params.Set(i, Napi::String::New(env, attributes.getParamAttrs(i).getAsString()));
+    }
+    result.Set("params", params);
+    return result;
+}
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <napi.h>
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Type.h>
+
+namespace llvm_nodejs {
+
+// Attribute helpers shared by functions, arguments and call sites. `index`
+// is an llvm::AttributeList index (FunctionIndex, ReturnIndex or
+// FirstArgIndex + argNo) and `valueType` the type of the return value or
+// parameter it refers to, null for function attributes. All of them throw
+// and return false on invalid input and leave `attributes` untouched.
+
+// Adds the attribute named by info[argIndex] with the value in
+// info[argIndex + 1]: nothing for enum attributes ("noalias", "readonly"),
+// a number for int attributes ("align", "dereferenceable"), a Type for type
+// attributes ("byval", "sret") and an optional string for any other name,
+// which becomes a string attribute ("target-cpu").
+bool AddAttribute(const Napi::CallbackInfo& info, size_t argIndex, llvm::LLVMContext& context,
+                  llvm::AttributeList& attributes, unsigned index, llvm::Type* valueType);
+
+// Removes the attribute named by info[argIndex]
+bool RemoveAttribute(const Napi::CallbackInfo& info, size_t argIndex, llvm::LLVMContext& context,
+                     llvm::AttributeList& attributes, unsigned index);
+
+// Reads whether the attribute named by info[argIndex] is present
+bool HasAttribute(const Napi::CallbackInfo& info, size_t argIndex, const llvm::AttributeList& attributes,
+                  unsigned index, bool& result);
+
+// setMemoryEffects(access, location): access is 'none', 'read', 'write' or
+// 'readwrite' and location 'any' (default), 'argmem', 'inaccessiblemem' or
+// 'inaccessiblemem-or-argmem'. Replaces readnone/readonly/writeonly and the
+// *memonly attributes on the function.
+bool SetMemoryEffects(const Napi::CallbackInfo& info, size_t argIndex, llvm::LLVMContext& context,
+                      llvm::AttributeList& attributes);
+
+// { function, return, params } with the attributes of each position in IR
+// syntax
+Napi::Object DescribeAttributes(Napi::Env env, const llvm::AttributeList& attributes, unsigned paramCount);
+
+}  // namespace llvm_nodejs
@@ -3,6 +3,9 @@
 #include "llvm_function.h"
 #include "llvm_context.h"
 #include "llvm_module.h"
+#include "llvm_async.h"
+#include "llvm_attributes.h"
+#include "llvm_loop_hints.h"
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Function.h>
@@ -13,12 +16,12 @@
 namespace llvm_nodejs {
 
 // Initialize the static constructor reference for IRBuilderWrapper
-Napi::FunctionReference IRBuilderWrapper::constructor;
-Napi::FunctionReference PHINodeWrapper::constructor;
-Napi::FunctionReference ValueWrapper::constructor;
-Napi::FunctionReference ConstantWrapper::constructor;
-Napi::FunctionReference InstructionWrapper::constructor;
-Napi::FunctionReference BasicBlockWrapper::constructor;
+thread_local Napi::FunctionReference IRBuilderWrapper::constructor;
+thread_local Napi::FunctionReference PHINodeWrapper::constructor;
+thread_local Napi::FunctionReference ValueWrapper::constructor;
+thread_local Napi::FunctionReference ConstantWrapper::constructor;
+thread_local Napi::FunctionReference InstructionWrapper::constructor;
+thread_local Napi::FunctionReference BasicBlockWrapper::constructor;
 
 // Implementation of wrapper constructors
 ValueWrapper::ValueWrapper(const Napi::CallbackInfo& info) 
@@ -27,6 +30,7 @@ ValueWrapper::ValueWrapper(const Napi::CallbackInfo& info)
     
     if (info.Length() == 1 && info[0].IsExternal()) {
         value_ = static_cast<llvm::Value*>(info[0].As<Napi::External<llvm::Value>>().Data());
+        handle_ = GetModuleHandle(value_);
     } else {
         Napi::TypeError::New(env, "ValueWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
@@ -39,6 +43,7 @@ ConstantWrapper::ConstantWrapper(const Napi::CallbackInfo& info)
     
     if (info.Length() == 1 && info[0].IsExternal()) {
         constant_ = static_cast<llvm::Constant*>(info[0].As<Napi::External<llvm::Constant>>().Data());
+        handle_ = GetModuleHandle(constant_);
     } else {
         Napi::TypeError::New(env, "ConstantWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
@@ -51,6 +56,7 @@ InstructionWrapper::InstructionWrapper(const Napi::CallbackInfo& info)
     
     if (info.Length() == 1 && info[0].IsExternal()) {
         instruction_ = static_cast<llvm::Instruction*>(info[0].As<Napi::External<llvm::Instruction>>().Data());
+        handle_ = GetModuleHandle(instruction_);
     } else {
         Napi::TypeError::New(env, "InstructionWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
@@ -63,12 +69,33 @@ BasicBlockWrapper::BasicBlockWrapper(const Napi::CallbackInfo& info)
     
     if (info.Length() == 1 && info[0].IsExternal()) {
         basicBlock_ = static_cast<llvm::BasicBlock*>(info[0].As<Napi::External<llvm::BasicBlock>>().Data());
+        handle_ = GetModuleHandle(basicBlock_);
     } else {
         Napi::TypeError::New(env, "BasicBlockWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
     }
 }
 
+llvm::Value* ValueWrapper::GetValue() const {
+    return handle_ && handle_->IsReleased() ? nullptr : value_;
+}
+
+llvm::Constant* ConstantWrapper::GetConstant() const {
+    return handle_ && handle_->IsReleased() ? nullptr : constant_;
+}
+
+llvm::Instruction* InstructionWrapper::GetInstruction() const {
+    return handle_ && handle_->IsReleased() ? nullptr : instruction_;
+}
+
+llvm::BasicBlock* BasicBlockWrapper::GetBasicBlock() const {
+    return handle_ && handle_->IsReleased() ? nullptr : basicBlock_;
+}
+
+llvm::PHINode* PHINodeWrapper::GetPHINode() const {
+    return handle_ && handle_->IsReleased() ? nullptr : phiNode_;
+}
+
 // Static Create methods for wrappers
 Napi::Object ValueWrapper::Create(Napi::Env env, llvm::Value* value) {
     Napi::External<llvm::Value> external = Napi::External<llvm::Value>::New(env, value);
@@ -131,6 +158,10 @@ IRBuilderWrapper::IRBuilderWrapper(const Napi::CallbackInfo& info)
     }
 }
 
+bool IRBuilderWrapper::CheckContext(Napi::Env env) {
+    return CheckModuleHandle(env, handle_) && CheckContextUnlocked(env, builder_->getContext());
+}
+
 IRBuilderWrapper::~IRBuilderWrapper() {
     if (builder_) {
         delete builder_;
@@ -242,6 +273,9 @@ Napi::Value IRBuilderWrapper::WrapValue(Napi::Env env, llvm::Value* value) {
 
 Napi::Value IRBuilderWrapper::CreateRetVoid(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     llvm::ReturnInst* ret = builder_->CreateRetVoid();
     return WrapValue(env, ret);
@@ -249,6 +283,9 @@ Napi::Value IRBuilderWrapper::CreateRetVoid(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateRet(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsObject()) {
         Napi::TypeError::New(env, "Value argument expected")
@@ -269,6 +306,9 @@ Napi::Value IRBuilderWrapper::CreateRet(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateAdd(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -298,6 +338,9 @@ Napi::Value IRBuilderWrapper::CreateAdd(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateSub(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -325,6 +368,9 @@ Napi::Value IRBuilderWrapper::CreateSub(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateMul(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -352,6 +398,9 @@ Napi::Value IRBuilderWrapper::CreateMul(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateICmpEQ(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -379,6 +428,9 @@ Napi::Value IRBuilderWrapper::CreateICmpEQ(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateICmpNE(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -406,6 +458,9 @@ Napi::Value IRBuilderWrapper::CreateICmpNE(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateICmpSLT(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -433,6 +488,9 @@ Napi::Value IRBuilderWrapper::CreateICmpSLT(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateICmpSGT(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Two value arguments expected")
@@ -460,6 +518,9 @@ Napi::Value IRBuilderWrapper::CreateICmpSGT(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateBr(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsObject()) {
         Napi::TypeError::New(env, "BasicBlock argument expected")
@@ -488,6 +549,9 @@ Napi::Value IRBuilderWrapper::CreateBr(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateCondBr(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 3 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject()) {
         Napi::TypeError::New(env, "Condition and two BasicBlock arguments expected")
@@ -522,6 +586,9 @@ Napi::Value IRBuilderWrapper::CreateCondBr(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::SetInsertPoint(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsObject()) {
         Napi::TypeError::New(env, "BasicBlock argument expected")
@@ -545,11 +612,15 @@ Napi::Value IRBuilderWrapper::SetInsertPoint(const Napi::CallbackInfo& info) {
     }
     
     builder_->SetInsertPoint(block);
+    handle_ = GetModuleHandle(block);
     return env.Undefined();
 }
 
 Napi::Value IRBuilderWrapper::GetInsertBlock(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleHandle(env, handle_)) {
+        return env.Undefined();
+    }
     
     llvm::BasicBlock* block = builder_->GetInsertBlock();
     if (!block) {
@@ -562,6 +633,9 @@ Napi::Value IRBuilderWrapper::GetInsertBlock(const Napi::CallbackInfo& info) {
 // Add more builder methods for completeness
 Napi::Value IRBuilderWrapper::CreateAlloca(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsObject()) {
         Napi::TypeError::New(env, "Type argument expected")
@@ -589,6 +663,9 @@ Napi::Value IRBuilderWrapper::CreateAlloca(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateLoad(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsObject()) {
         Napi::TypeError::New(env, "Value argument expected")
@@ -619,6 +696,9 @@ Napi::Value IRBuilderWrapper::CreateLoad(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateStore(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Value and pointer arguments expected")
@@ -641,6 +721,9 @@ Napi::Value IRBuilderWrapper::CreateStore(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateCall(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsArray()) {
         Napi::TypeError::New(env, "Function and arguments array expected")
@@ -655,7 +738,7 @@ Napi::Value IRBuilderWrapper::CreateCall(const Napi::CallbackInfo& info) {
         function = Napi::ObjectWrap<FunctionWrapper>::Unwrap(funcObj)->GetFunction();
     } else {
         llvm::Value* funcValue = UnwrapValue(info[0]);
-        if (llvm::isa<llvm::Function>(funcValue)) {
+        if (llvm::isa_and_nonnull<llvm::Function>(funcValue)) {
             function = llvm::cast<llvm::Function>(funcValue);
         }
     }
@@ -692,6 +775,9 @@ Napi::Value IRBuilderWrapper::CreateCall(const Napi::CallbackInfo& info) {
 // Additional methods implementation
 Napi::Value IRBuilderWrapper::CreateGEP(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsArray()) {
         Napi::TypeError::New(env, "Pointer and indices array expected")
@@ -731,6 +817,9 @@ Napi::Value IRBuilderWrapper::CreateGEP(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreatePHI(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsNumber()) {
         Napi::TypeError::New(env, "Type and number of reserved values expected")
@@ -762,6 +851,9 @@ Napi::Value IRBuilderWrapper::CreatePHI(const Napi::CallbackInfo& info) {
 
 Napi::Value IRBuilderWrapper::CreateStructGEP(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckContext(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 3 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsNumber()) {
         Napi::TypeError::New(env, "Type, pointer, and index arguments expected")
@@ -827,7 +919,19 @@ Napi::Object ConstantWrapper::Init(Napi::Env env, Napi::Object exports) {
 
 Napi::Object InstructionWrapper::Init(Napi::Env env, Napi::Object exports) {
     Napi::Function func = DefineClass(env, "Instruction", {
-        // Add methods as needed
+        InstanceMethod("addAttribute", &InstructionWrapper::AddAttribute),
+        InstanceMethod("removeAttribute", &InstructionWrapper::RemoveAttribute),
+        InstanceMethod("hasAttribute", &InstructionWrapper::HasAttribute),
+        InstanceMethod("addReturnAttribute", &InstructionWrapper::AddReturnAttribute),
+        InstanceMethod("removeReturnAttribute", &InstructionWrapper::RemoveReturnAttribute),
+        InstanceMethod("addParamAttribute", &InstructionWrapper::AddParamAttribute),
+        InstanceMethod("removeParamAttribute", &InstructionWrapper::RemoveParamAttribute),
+        InstanceMethod("setMemoryEffects", &InstructionWrapper::SetMemoryEffects),
+        InstanceMethod("getAttributes", &InstructionWrapper::GetAttributes),
+        InstanceMethod("setTailCall", &InstructionWrapper::SetTailCall),
+        InstanceMethod("setLoopHints", &InstructionWrapper::SetLoopHints),
+        InstanceMethod("getLoopHints", &InstructionWrapper::GetLoopHints),
+        InstanceMethod("setAccessGroup", &InstructionWrapper::SetAccessGroup)
     });
     
     constructor = Napi::Persistent(func);
@@ -838,6 +942,249 @@ Napi::Object InstructionWrapper::Init(Napi::Env env, Napi::Object exports) {
 }
 
 
+llvm::CallBase* InstructionWrapper::GetCallSite(Napi::Env env, bool modify) {
+    if (!CheckModuleIR(env, handle_, instruction_, modify)) {
+        return nullptr;
+    }
+    llvm::CallBase* call = llvm::dyn_cast<llvm::CallBase>(instruction_);
+    if (!call) {
+        Napi::TypeError::New(env, "Instruction is not a call").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+    return call;
+}
+
+bool InstructionWrapper::GetParamIndex(const Napi::CallbackInfo& info, llvm::CallBase* call, unsigned& index) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(info.Env(), "Parameter index expected").ThrowAsJavaScriptException();
+        return false;
+    }
+    index = info[0].As<Napi::Number>().Uint32Value();
+    if (index >= call->arg_size()) {
+        Napi::RangeError::New(info.Env(), "Parameter index out of range").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+Napi::Value InstructionWrapper::AddAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    if (!call) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::AddAttribute(info, 0, call->getContext(), attributes, llvm::AttributeList::FunctionIndex,
+                                  nullptr)) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::RemoveAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    if (!call) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::RemoveAttribute(info, 0, call->getContext(), attributes,
+                                     llvm::AttributeList::FunctionIndex)) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::HasAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, false);
+    bool result = false;
+    if (!call || !llvm_nodejs::HasAttribute(info, 0, call->getAttributes(), llvm::AttributeList::FunctionIndex,
+                                            result)) {
+        return env.Undefined();
+    }
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value InstructionWrapper::AddReturnAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    if (!call) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::AddAttribute(info, 0, call->getContext(), attributes, llvm::AttributeList::ReturnIndex,
+                                  call->getType())) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::RemoveReturnAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    if (!call) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::RemoveAttribute(info, 0, call->getContext(), attributes,
+                                     llvm::AttributeList::ReturnIndex)) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+// addParamAttribute(index, name, value)
+Napi::Value InstructionWrapper::AddParamAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    unsigned index;
+    if (!call || !GetParamIndex(info, call, index)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::AddAttribute(info, 1, call->getContext(), attributes,
+                                  llvm::AttributeList::FirstArgIndex + index,
+                                  call->getArgOperand(index)->getType())) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::RemoveParamAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    unsigned index;
+    if (!call || !GetParamIndex(info, call, index)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::RemoveAttribute(info, 1, call->getContext(), attributes,
+                                     llvm::AttributeList::FirstArgIndex + index)) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::SetMemoryEffects(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, true);
+    if (!call) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = call->getAttributes();
+    if (llvm_nodejs::SetMemoryEffects(info, 0, call->getContext(), attributes)) {
+        call->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::GetAttributes(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    llvm::CallBase* call = GetCallSite(env, false);
+    if (!call) {
+        return env.Undefined();
+    }
+    return DescribeAttributes(env, call->getAttributes(), call->arg_size());
+}
+
+// setTailCall(kind): 'tail', 'musttail', 'notail' or 'none'; a boolean picks
+// between 'tail' and 'none'
+Napi::Value InstructionWrapper::SetTailCall(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, instruction_, true)) {
+        return env.Undefined();
+    }
+    llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(instruction_);
+    if (!call) {
+        Napi::TypeError::New(env, "Instruction is not a call").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string kind = "tail";
+    if (info.Length() > 0 && info[0].IsBoolean()) {
+        kind = info[0].As<Napi::Boolean>().Value() ? "tail" : "none";
+    } else if (info.Length() > 0 && info[0].IsString()) {
+        kind = info[0].As<Napi::String>().Utf8Value();
+    }
+
+    if (kind == "tail") {
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+    } else if (kind == "musttail") {
+        call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+    } else if (kind == "notail") {
+        call->setTailCallKind(llvm::CallInst::TCK_NoTail);
+    } else if (kind == "none") {
+        call->setTailCallKind(llvm::CallInst::TCK_None);
+    } else {
+        Napi::RangeError::New(env, "Tail call kind must be 'tail', 'musttail', 'notail' or 'none'")
+            .ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// setLoopHints({ vectorize, vectorizeWidth, interleaveCount, unroll,
+// unrollCount, unrollFull, parallelAccesses, mustProgress }) on the branch
+// that jumps back to the loop header
+Napi::Value InstructionWrapper::SetLoopHints(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, instruction_, true)) {
+        return env.Undefined();
+    }
+    if (!llvm::isa<llvm::BranchInst>(instruction_)) {
+        Napi::TypeError::New(env, "Loop hints belong on the loop's back-edge branch")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Loop hints object expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    llvm_nodejs::SetLoopHints(env, instruction_, info[0].As<Napi::Object>());
+    return env.Undefined();
+}
+
+Napi::Value InstructionWrapper::GetLoopHints(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, instruction_, false)) {
+        return env.Undefined();
+    }
+    return llvm_nodejs::GetLoopHints(env, instruction_);
+}
+
+// setAccessGroup(group) with a group from context.createAccessGroup(), or
+// null to take the instruction out of its group
+Napi::Value InstructionWrapper::SetAccessGroup(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, instruction_, true)) {
+        return env.Undefined();
+    }
+    if (!instruction_->mayReadOrWriteMemory()) {
+        Napi::TypeError::New(env, "Instruction does not access memory").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (info.Length() > 0 && info[0].IsNull()) {
+        instruction_->setMetadata(llvm::LLVMContext::MD_access_group, nullptr);
+        return env.Undefined();
+    }
+    llvm::MDNode* group = info.Length() > 0 ? GetAccessGroup(IRBuilderWrapper::UnwrapValue(info[0])) : nullptr;
+    if (!group) {
+        Napi::TypeError::New(env, "Access group expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    instruction_->setMetadata(llvm::LLVMContext::MD_access_group, group);
+    return env.Undefined();
+}
+
 // Add the static method to create a basic block
 Napi::Value BasicBlockWrapper::CreateBasicBlock(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
@@ -856,6 +1203,9 @@ Napi::Value BasicBlockWrapper::CreateBasicBlock(const Napi::CallbackInfo& info)
         return env.Undefined();
     }
     llvm::LLVMContext& context = contextWrapper->GetContext();
+    if (!CheckContextUnlocked(env, context)) {
+        return env.Undefined();
+    }
     
     // Get the name
     std::string name = info[1].As<Napi::String>().Utf8Value();
@@ -868,6 +1218,10 @@ Napi::Value BasicBlockWrapper::CreateBasicBlock(const Napi::CallbackInfo& info)
         return env.Undefined();
     }
     llvm::Function* function = Napi::ObjectWrap<FunctionWrapper>::Unwrap(funcObj)->GetFunction();
+    if (!function) {
+        Napi::Error::New(env, "Module of this function is no longer available").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
     
     // Create the basic block
     llvm::BasicBlock* basicBlock = llvm::BasicBlock::Create(context, name, function);
@@ -899,6 +1253,7 @@ PHINodeWrapper::PHINodeWrapper(const Napi::CallbackInfo& info)
         // Unwrap the PHINode pointer passed from Create()
         phiNode_ = static_cast<llvm::PHINode*>(
             info[0].As<Napi::External<llvm::PHINode>>().Data());
+        handle_ = GetModuleHandle(phiNode_);
     } else {
         Napi::TypeError::New(env, "PHINodeWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
@@ -928,6 +1283,9 @@ Napi::Object PHINodeWrapper::Init(Napi::Env env, Napi::Object exports) {
 
 Napi::Value PHINodeWrapper::AddIncoming(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, phiNode_, true)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Value and BasicBlock arguments expected")
@@ -954,6 +1312,11 @@ Napi::Value PHINodeWrapper::AddIncoming(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
     llvm::BasicBlock* basicBlock = Napi::ObjectWrap<BasicBlockWrapper>::Unwrap(bbObj)->GetBasicBlock();
+    if (!basicBlock) {
+        Napi::TypeError::New(env, "Invalid basic block")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
     
     // Add the incoming value
     phiNode_->addIncoming(value, basicBlock);
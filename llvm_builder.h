@@ -3,9 +3,14 @@
 #include <napi.h>
 #include <llvm/IR/IRBuilder.h>
 #include "llvm_types.h"
+#include <memory>
 
 namespace llvm_nodejs {
 
+// IR wrappers check the handle of their module before touching the IR, see
+// llvm_module.h. Their getters return null once the module is released.
+struct ModuleHandle;
+
 class IRBuilderWrapper : public Napi::ObjectWrap<IRBuilderWrapper> {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
@@ -18,10 +23,14 @@ public:
 
     static llvm::Value* UnwrapValue(const Napi::Value& value);
 private:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     
     // Helper methods
     static Napi::Value WrapValue(Napi::Env env, llvm::Value* value);
+
+    // Throws and returns false if the module of the insert block has been
+    // released or an async job holds the builder's context
+    bool CheckContext(Napi::Env env);
     
     // IRBuilder methods
     Napi::Value CreateRetVoid(const Napi::CallbackInfo& info);
@@ -47,83 +56,116 @@ private:
     Napi::Value CreatePHI(const Napi::CallbackInfo& info);
     
     llvm::IRBuilder<>* builder_ = nullptr;
+    // Module of the insert block
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 // Define the wrapper classes before using their static members
 // Base Value wrapper class
 class ValueWrapper : public Napi::ObjectWrap<ValueWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::Value* value);
     
     ValueWrapper(const Napi::CallbackInfo& info);
-    llvm::Value* GetValue() const { return value_; }
+    llvm::Value* GetValue() const;
     
 private:
     llvm::Value* value_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 // Constant wrapper class
 class ConstantWrapper : public Napi::ObjectWrap<ConstantWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::Constant* constant);
     
     ConstantWrapper(const Napi::CallbackInfo& info);
-    llvm::Constant* GetConstant() const { return constant_; }
+    llvm::Constant* GetConstant() const;
     
 private:
     llvm::Constant* constant_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 // Instruction wrapper class
 class InstructionWrapper : public Napi::ObjectWrap<InstructionWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::Instruction* instruction);
     
     InstructionWrapper(const Napi::CallbackInfo& info);
-    llvm::Instruction* GetInstruction() const { return instruction_; }
+    llvm::Instruction* GetInstruction() const;
+
+    // Call site attributes, e.g. alwaysinline on a single call, and the
+    // tail call marker. Only valid on call instructions.
+    Napi::Value AddAttribute(const Napi::CallbackInfo& info);
+    Napi::Value RemoveAttribute(const Napi::CallbackInfo& info);
+    Napi::Value HasAttribute(const Napi::CallbackInfo& info);
+    Napi::Value AddReturnAttribute(const Napi::CallbackInfo& info);
+    Napi::Value RemoveReturnAttribute(const Napi::CallbackInfo& info);
+    Napi::Value AddParamAttribute(const Napi::CallbackInfo& info);
+    Napi::Value RemoveParamAttribute(const Napi::CallbackInfo& info);
+    Napi::Value SetMemoryEffects(const Napi::CallbackInfo& info);
+    Napi::Value GetAttributes(const Napi::CallbackInfo& info);
+    Napi::Value SetTailCall(const Napi::CallbackInfo& info);
+
+    // Loop hints on the back-edge branch of a loop, and the access group a
+    // load, store or call belongs to
+    Napi::Value SetLoopHints(const Napi::CallbackInfo& info);
+    Napi::Value GetLoopHints(const Napi::CallbackInfo& info);
+    Napi::Value SetAccessGroup(const Napi::CallbackInfo& info);
     
 private:
+    // Throws and returns null unless the instruction is a call (and, when
+    // `modify` is set, its context is not held by an async job)
+    llvm::CallBase* GetCallSite(Napi::Env env, bool modify);
+
+    // Reads the parameter index in info[0] and throws if it is out of range
+    bool GetParamIndex(const Napi::CallbackInfo& info, llvm::CallBase* call, unsigned& index);
+
     llvm::Instruction* instruction_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 // BasicBlock wrapper class
 class BasicBlockWrapper : public Napi::ObjectWrap<BasicBlockWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::BasicBlock* basicBlock);
     
     BasicBlockWrapper(const Napi::CallbackInfo& info);
-    llvm::BasicBlock* GetBasicBlock() const { return basicBlock_; }
+    llvm::BasicBlock* GetBasicBlock() const;
     
     // Add static method to create a basic block
     static Napi::Value CreateBasicBlock(const Napi::CallbackInfo& info);
     
 private:
     llvm::BasicBlock* basicBlock_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 // PHINode wrapper class
 class PHINodeWrapper : public Napi::ObjectWrap<PHINodeWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::PHINode* phiNode);
     
     PHINodeWrapper(const Napi::CallbackInfo& info);
-    llvm::PHINode* GetPHINode() const { return phiNode_; }
+    llvm::PHINode* GetPHINode() const;
     
     // Methods for PHINode
     Napi::Value AddIncoming(const Napi::CallbackInfo& info);
     
 private:
     llvm::PHINode* phiNode_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 
@@ -0,0 +1,173 @@
+#include "llvm_cache.h"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace llvm_nodejs {
+
+// Bump when the key or file layout changes so that old entries are ignored
+static const char* const cacheFormatVersion = "1";
+static const char* const objectExtension = ".o";
+
+DiskObjectCache::DiskObjectCache(const std::string& directory, uint64_t maxBytes,
+                                 const std::string& configuration)
+    : directory_(directory), maxBytes_(maxBytes), configuration_(configuration),
+      hits_(0), misses_(0), evictions_(0) {}
+
+llvm::Expected<std::unique_ptr<DiskObjectCache>> DiskObjectCache::Create(
+    const std::string& directory, uint64_t maxBytes, const std::string& configuration) {
+    if (std::error_code ec = llvm::sys::fs::create_directories(directory)) {
+        return llvm::createStringError(ec, "Cannot create cache directory %s", directory.c_str());
+    }
+    return std::unique_ptr<DiskObjectCache>(new DiskObjectCache(directory, maxBytes, configuration));
+}
+
+std::string DiskObjectCache::KeyFor(const llvm::Module& module) const {
+    std::string bitcode;
+    llvm::raw_string_ostream bitcodeStream(bitcode);
+    llvm::WriteBitcodeToFile(module, bitcodeStream);
+    bitcodeStream.flush();
+
+    llvm::SHA1 hasher;
+    hasher.update(cacheFormatVersion);
+    hasher.update(LLVM_VERSION_STRING);
+    hasher.update(configuration_);
+    hasher.update(bitcode);
+    return llvm::toHex(hasher.final(), true);
+}
+
+std::string DiskObjectCache::PathFor(const std::string& key) const {
+    llvm::SmallString<256> path(directory_);
+    llvm::sys::path::append(path, key + objectExtension);
+    return path.str().str();
+}
+
+std::unique_ptr<llvm::MemoryBuffer> DiskObjectCache::getObject(const llvm::Module* module) {
+    std::string key = KeyFor(*module);
+    std::string path = PathFor(key);
+
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        misses_++;
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingKeys_[module] = key;
+        return nullptr;
+    }
+
+    // The modification time doubles as the last use for LRU eviction
+    int fd;
+    if (!llvm::sys::fs::openFileForWrite(path, fd, llvm::sys::fs::CD_OpenExisting,
+                                         llvm::sys::fs::OF_Append)) {
+        llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingKeys_.erase(module);
+    }
+    hits_++;
+    return std::move(*buffer);
+}
+
+void DiskObjectCache::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) {
+    std::string key;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pendingKeys_.find(module);
+        if (it == pendingKeys_.end()) {
+            return;
+        }
+        key = std::move(it->second);
+        pendingKeys_.erase(it);
+    }
+
+    // Write to a private temporary file and rename it into place, so that
+    // readers in other processes never see a partial object
+    llvm::SmallString<256> model(directory_);
+    llvm::sys::path::append(model, key + "-%%%%%%%%.tmp");
+    int fd;
+    llvm::SmallString<256> tempPath;
+    if (llvm::sys::fs::createUniqueFile(model, fd, tempPath)) {
+        return;
+    }
+    {
+        llvm::raw_fd_ostream stream(fd, /*shouldClose=*/true);
+        stream << object.getBuffer();
+        stream.close();
+        if (stream.has_error()) {
+            stream.clear_error();
+            llvm::sys::fs::remove(tempPath);
+            return;
+        }
+    }
+    if (llvm::sys::fs::rename(tempPath, PathFor(key))) {
+        llvm::sys::fs::remove(tempPath);
+        return;
+    }
+
+    if (maxBytes_ > 0) {
+        EvictToSize();
+    }
+}
+
+void DiskObjectCache::EvictToSize() {
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        llvm::sys::TimePoint<> lastUsed;
+    };
+
+    // Other processes may add entries too, so the directory itself is the
+    // source of truth for the current size
+    std::vector<Entry> entries;
+    uint64_t totalBytes = 0;
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator it(directory_, ec), end; it != end && !ec; it.increment(ec)) {
+        if (!llvm::StringRef(it->path()).endswith(objectExtension)) {
+            continue;
+        }
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(it->path(), status)) {
+            continue;
+        }
+        entries.push_back({it->path(), status.getSize(), status.getLastModificationTime()});
+        totalBytes += status.getSize();
+    }
+    if (totalBytes <= maxBytes_) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+    for (const Entry& entry : entries) {
+        if (totalBytes <= maxBytes_) {
+            break;
+        }
+        // Another process may have evicted the entry already
+        if (!llvm::sys::fs::remove(entry.path, /*IgnoreNonExisting=*/false)) {
+            evictions_++;
+        }
+        totalBytes -= entry.size;
+    }
+}
+
+ObjectCacheStats DiskObjectCache::GetStats() const {
+    ObjectCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    return stats;
+}
+
+}  // namespace llvm_nodejs
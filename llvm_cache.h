@@ -0,0 +1,59 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace llvm_nodejs {
+
+struct ObjectCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+// Object cache backed by a directory that several processes may share.
+// Entries are keyed by a hash of the module bitcode and the code generator
+// configuration, written atomically (temporary file + rename) and evicted
+// least recently used first once the directory exceeds its size cap.
+class DiskObjectCache : public llvm::ObjectCache {
+public:
+    // `configuration` identifies everything besides the IR that changes the
+    // generated code, e.g. triple, CPU and features. A `maxBytes` of 0 means
+    // no size cap.
+    static llvm::Expected<std::unique_ptr<DiskObjectCache>> Create(
+        const std::string& directory, uint64_t maxBytes, const std::string& configuration);
+
+    void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+    ObjectCacheStats GetStats() const;
+
+private:
+    DiskObjectCache(const std::string& directory, uint64_t maxBytes, const std::string& configuration);
+
+    std::string KeyFor(const llvm::Module& module) const;
+    std::string PathFor(const std::string& key) const;
+    void EvictToSize();
+
+    std::string directory_;
+    uint64_t maxBytes_;
+    std::string configuration_;
+
+    // Keys computed by getObject for modules that are now being compiled
+    std::mutex mutex_;
+    std::map<const llvm::Module*, std::string> pendingKeys_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+};
+
+}  // namespace llvm_nodejs
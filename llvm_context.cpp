@@ -1,18 +1,31 @@
 #include "llvm_context.h"
 #include "llvm_module.h"
+#include "llvm_async.h"
+#include "llvm_builder.h"
+#include "llvm_linker.h"
+#include "llvm_loop_hints.h"
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/MemoryBuffer.h>
 
 namespace llvm_nodejs {
 
 LLVMContextWrapper::LLVMContextWrapper(const Napi::CallbackInfo& info) 
     : Napi::ObjectWrap<LLVMContextWrapper>(info) {
-    context_ = std::make_unique<llvm::LLVMContext>();
+    context_ = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
 }
 
 Napi::Object LLVMContextWrapper::Init(Napi::Env env, Napi::Object exports) {
     Napi::Function func = DefineClass(env, "LLVMContext", {
-        InstanceMethod("createModule", &LLVMContextWrapper::CreateModule)
+        InstanceMethod("createModule", &LLVMContextWrapper::CreateModule),
+        InstanceMethod("createAccessGroup", &LLVMContextWrapper::CreateAccessGroup),
+        InstanceMethod("loadBitcodeLibrary", &LLVMContextWrapper::LoadBitcodeLibrary),
+        InstanceMethod("loadBitcodeLazy", &LLVMContextWrapper::LoadBitcodeLazy),
+        InstanceMethod("parseBitcode", &LLVMContextWrapper::ParseBitcode),
+        InstanceMethod("parseIR", &LLVMContextWrapper::ParseIR)
     });
 
     exports.Set("LLVMContext", func);
@@ -34,16 +47,165 @@ Napi::Value LLVMContextWrapper::CreateModule(const Napi::CallbackInfo& info) {
         return env.Null();
     }
 
+    if (!CheckContextUnlocked(env, GetContext())) {
+        return env.Null();
+    }
+
     std::string name = info[0].As<Napi::String>().Utf8Value();
     
     // Create a new LLVM module
     std::unique_ptr<llvm::Module> module = 
-        std::make_unique<llvm::Module>(name, *context_);
+        std::make_unique<llvm::Module>(name, GetContext());
     
     // Create and return a ModuleWrapper object
-    return ModuleWrapper::Create(env, std::move(module));
+    return ModuleWrapper::Create(env, llvm::orc::ThreadSafeModule(std::move(module), context_));
+}
+
+// Access groups tie the memory accesses of a loop body to the loop's
+// parallelAccesses hint
+Napi::Value LLVMContextWrapper::CreateAccessGroup(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckContextUnlocked(env, GetContext())) {
+        return env.Null();
+    }
+    return ValueWrapper::Create(env, llvm_nodejs::CreateAccessGroup(GetContext()));
+}
+
+// loadBitcodeLibrary(path | Buffer). A file is parsed only once per
+// context; loading it again returns the same library.
+Napi::Value LLVMContextWrapper::LoadBitcodeLibrary(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || (!info[0].IsString() && !info[0].IsBuffer())) {
+        Napi::TypeError::New(env, "Bitcode file path or Buffer expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!CheckContextUnlocked(env, GetContext())) {
+        return env.Null();
+    }
+
+    std::string path;
+    std::unique_ptr<llvm::MemoryBuffer> bitcode;
+    if (info[0].IsString()) {
+        path = info[0].As<Napi::String>().Utf8Value();
+        auto cached = libraries_.find(path);
+        if (cached != libraries_.end()) {
+            return BitcodeLibraryWrapper::Create(env, context_, cached->second);
+        }
+        auto file = llvm::MemoryBuffer::getFile(path);
+        if (!file) {
+            Napi::Error::New(env, "Failed to read bitcode library " + path + ": " + file.getError().message())
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        bitcode = std::move(*file);
+    } else {
+        Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
+        bitcode = llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(buffer.Data(), buffer.Length()),
+                                                       "bitcode library");
+    }
+
+    auto library = BitcodeLibraryWrapper::Parse(GetContext(), std::move(bitcode));
+    if (!library) {
+        Napi::Error::New(env, "Failed to load bitcode library: " + llvm::toString(library.takeError()))
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::shared_ptr<llvm::Module> shared(std::move(*library));
+    if (!path.empty()) {
+        libraries_[path] = shared;
+    }
+    return BitcodeLibraryWrapper::Create(env, context_, std::move(shared));
+}
+
+// loadBitcodeLazy(path) maps a library file and reads only declarations;
+// linking reads the bodies of the functions the module needs. It shares the
+// per-context cache with loadBitcodeLibrary().
+Napi::Value LLVMContextWrapper::LoadBitcodeLazy(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Bitcode file path expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!CheckContextUnlocked(env, GetContext())) {
+        return env.Null();
+    }
+
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    auto cached = libraries_.find(path);
+    if (cached != libraries_.end()) {
+        return BitcodeLibraryWrapper::Create(env, context_, cached->second);
+    }
+
+    auto library = BitcodeLibraryWrapper::ParseLazy(GetContext(), path);
+    if (!library) {
+        Napi::Error::New(env, "Failed to load bitcode library " + path + ": " + llvm::toString(library.takeError()))
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::shared_ptr<llvm::Module> shared(std::move(*library));
+    libraries_[path] = shared;
+    return BitcodeLibraryWrapper::Create(env, context_, std::move(shared));
+}
+
+// parseBitcode(buffer) reads a module written by module.toBitcode() into
+// this context
+Napi::Value LLVMContextWrapper::ParseBitcode(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsBuffer()) {
+        Napi::TypeError::New(env, "Bitcode Buffer expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!CheckContextUnlocked(env, GetContext())) {
+        return env.Null();
+    }
+
+    // The module is fully materialized before parseBitcodeFile returns, so
+    // the Buffer can be read in place
+    Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
+    llvm::MemoryBufferRef bitcode(llvm::StringRef(buffer.Data(), buffer.Length()), "bitcode");
+    auto module = llvm::parseBitcodeFile(bitcode, GetContext());
+    if (!module) {
+        Napi::Error::New(env, "Failed to parse bitcode: " + llvm::toString(module.takeError()))
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    // Bitcode only records the source file name, which createModule() sets
+    // to the module name
+    (*module)->setModuleIdentifier((*module)->getSourceFileName());
+    return ModuleWrapper::Create(env, llvm::orc::ThreadSafeModule(std::move(*module), context_));
 }
 
+// parseIR(text) reads textual IR as printed by module.dump()
+Napi::Value LLVMContextWrapper::ParseIR(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || (!info[0].IsString() && !info[0].IsBuffer())) {
+        Napi::TypeError::New(env, "IR string or Buffer expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!CheckContextUnlocked(env, GetContext())) {
+        return env.Null();
+    }
+
+    std::string text;
+    if (info[0].IsString()) {
+        text = info[0].As<Napi::String>().Utf8Value();
+    } else {
+        Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
+        text.assign(buffer.Data(), buffer.Length());
+    }
 
+    llvm::SMDiagnostic diagnostic;
+    std::unique_ptr<llvm::Module> module = llvm::parseAssemblyString(text, diagnostic, GetContext());
+    if (!module) {
+        std::string message;
+        llvm::raw_string_ostream messageStream(message);
+        diagnostic.print("", messageStream, false);
+        messageStream.flush();
+        Napi::Error::New(env, "Failed to parse IR: " + message).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    module->setModuleIdentifier(module->getSourceFileName());
+    return ModuleWrapper::Create(env, llvm::orc::ThreadSafeModule(std::move(module), context_));
+}
 
 }  // namespace llvm_nodejs
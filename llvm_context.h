@@ -2,7 +2,10 @@
 
 #include <napi.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <map>
 #include <memory>
+#include <string>
 
 namespace llvm_nodejs {
 
@@ -12,12 +15,24 @@ public:
     LLVMContextWrapper(const Napi::CallbackInfo& info);
     
     // Getter for the internal context
-    llvm::LLVMContext& GetContext() { return *context_; }
+    llvm::LLVMContext& GetContext() { return *context_.getContext(); }
+
+    // The context is shared with every module created from it so that the
+    // modules can outlive this wrapper (e.g. once handed to a JITEngine)
+    llvm::orc::ThreadSafeContext GetThreadSafeContext() const { return context_; }
 
 private:
     Napi::Value CreateModule(const Napi::CallbackInfo& info);
+    Napi::Value CreateAccessGroup(const Napi::CallbackInfo& info);
+    Napi::Value LoadBitcodeLibrary(const Napi::CallbackInfo& info);
+    Napi::Value LoadBitcodeLazy(const Napi::CallbackInfo& info);
+    Napi::Value ParseBitcode(const Napi::CallbackInfo& info);
+    Napi::Value ParseIR(const Napi::CallbackInfo& info);
     
-    std::unique_ptr<llvm::LLVMContext> context_;
+    llvm::orc::ThreadSafeContext context_;
+    // Runtime libraries loaded from files, parsed once per context. Declared
+    // after context_ so that they are destroyed before it.
+    std::map<std::string, std::shared_ptr<llvm::Module>> libraries_;
 };
 
 // Module initialization function
@@ -1,15 +1,22 @@
 #include <napi.h>
 
 #include "llvm_function.h"
+#include "llvm_attributes.h"
+#include "llvm_loop_hints.h"
 #include "llvm_builder.h"
+#include "llvm_async.h"
+#include "llvm_module.h"
+#include "llvm_passes.h"
+#include "llvm_print.h"
+#include "llvm_target.h"
 #include <llvm/IR/Function.h>
 #include <iostream>
 
 namespace llvm_nodejs {
 
 // Initialize the static constructor reference
-Napi::FunctionReference FunctionWrapper::constructor;
-Napi::FunctionReference ArgumentWrapper::constructor;
+thread_local Napi::FunctionReference FunctionWrapper::constructor;
+thread_local Napi::FunctionReference ArgumentWrapper::constructor;
 
 // FunctionWrapper implementation
 FunctionWrapper::FunctionWrapper(const Napi::CallbackInfo& info)
@@ -19,12 +26,17 @@ FunctionWrapper::FunctionWrapper(const Napi::CallbackInfo& info)
     if (info.Length() == 1 && info[0].IsExternal()) {
         function_ = static_cast<llvm::Function*>(
             info[0].As<Napi::External<llvm::Function>>().Data());
+        handle_ = GetModuleHandle(function_);
     } else {
         Napi::TypeError::New(env, "FunctionWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
     }
 }
 
+llvm::Function* FunctionWrapper::GetFunction() const {
+    return handle_ && handle_->IsReleased() ? nullptr : function_;
+}
+
 Napi::Object FunctionWrapper::Init(Napi::Env env, Napi::Object exports) {
     Napi::Function func = DefineClass(env, "Function", {
         InstanceMethod("getName", &FunctionWrapper::GetName),
@@ -34,7 +46,17 @@ Napi::Object FunctionWrapper::Init(Napi::Env env, Napi::Object exports) {
         InstanceMethod("getArgument", &FunctionWrapper::GetArgument),
         InstanceMethod("createBasicBlock", &FunctionWrapper::CreateBasicBlock),
         InstanceMethod("getBasicBlocks", &FunctionWrapper::GetBasicBlocks),
-        InstanceMethod("dump", &FunctionWrapper::Dump)
+        InstanceMethod("dump", &FunctionWrapper::Dump),
+        InstanceMethod("printTo", &FunctionWrapper::PrintTo),
+        InstanceMethod("runPasses", &FunctionWrapper::RunPasses),
+        InstanceMethod("addAttribute", &FunctionWrapper::AddAttribute),
+        InstanceMethod("removeAttribute", &FunctionWrapper::RemoveAttribute),
+        InstanceMethod("hasAttribute", &FunctionWrapper::HasAttribute),
+        InstanceMethod("addReturnAttribute", &FunctionWrapper::AddReturnAttribute),
+        InstanceMethod("removeReturnAttribute", &FunctionWrapper::RemoveReturnAttribute),
+        InstanceMethod("setMemoryEffects", &FunctionWrapper::SetMemoryEffects),
+        InstanceMethod("getAttributes", &FunctionWrapper::GetAttributes),
+        InstanceMethod("getLoopHints", &FunctionWrapper::GetLoopHints)
     });
 
     constructor = Napi::Persistent(func);
@@ -51,11 +73,17 @@ Napi::Object FunctionWrapper::Create(Napi::Env env, llvm::Function* function) {
 
 Napi::Value FunctionWrapper::GetName(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
     return Napi::String::New(env, function_->getName().str());
 }
 
 Napi::Value FunctionWrapper::SetName(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsString()) {
         Napi::TypeError::New(env, "Expected string argument").ThrowAsJavaScriptException();
@@ -70,17 +98,26 @@ Napi::Value FunctionWrapper::SetName(const Napi::CallbackInfo& info) {
 
 Napi::Value FunctionWrapper::GetReturnType(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
     llvm::Type* returnType = function_->getReturnType();
     return TypeWrapper::Create(env, returnType);
 }
 
 Napi::Value FunctionWrapper::GetArgumentCount(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
     return Napi::Number::New(env, function_->arg_size());
 }
 
 Napi::Value FunctionWrapper::GetArgument(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsNumber()) {
         Napi::TypeError::New(env, "Expected index argument").ThrowAsJavaScriptException();
@@ -102,6 +139,9 @@ Napi::Value FunctionWrapper::GetArgument(const Napi::CallbackInfo& info) {
 
 Napi::Value FunctionWrapper::CreateBasicBlock(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
     
     std::string name = "";
     if (info.Length() >= 1 && info[0].IsString()) {
@@ -119,6 +159,9 @@ Napi::Value FunctionWrapper::CreateBasicBlock(const Napi::CallbackInfo& info) {
 
 Napi::Value FunctionWrapper::GetBasicBlocks(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
     
     Napi::Array blocks = Napi::Array::New(env);
     unsigned i = 0;
@@ -133,12 +176,164 @@ Napi::Value FunctionWrapper::GetBasicBlocks(const Napi::CallbackInfo& info) {
 
 Napi::Value FunctionWrapper::Dump(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
     std::string str;
     llvm::raw_string_ostream stream(str);
     function_->print(stream);
     return Napi::String::New(env, str);
 }
 
+Napi::Value FunctionWrapper::PrintTo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+    llvm::Function* function = function_;
+    llvm_nodejs::PrintTo(info, [function](llvm::raw_ostream& stream) { function->print(stream); });
+    return env.Undefined();
+}
+
+// runPasses("mem2reg,instcombine,gvn") runs a function pipeline on this
+// function only, e.g. to re-optimize a hot function without running the
+// module pipeline again
+Napi::Value FunctionWrapper::RunPasses(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Pass pipeline string expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (function_->isDeclaration()) {
+        Napi::Error::New(env, "Function has no body").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::string pipeline = info[0].As<Napi::String>().Utf8Value();
+
+    // Same target machine as the module's own optimize()
+    auto targetMachine = handle_ && handle_->targetOptions ? CreateTargetMachine(*handle_->targetOptions)
+                                                           : CreateTargetMachineForModule(*function_->getParent());
+    if (!targetMachine) {
+        llvm::consumeError(targetMachine.takeError());
+    }
+    if (llvm::Error err = RunFunctionPassPipeline(*function_, pipeline,
+                                                  targetMachine ? targetMachine->get() : nullptr)) {
+        ThrowPassPipelineError(env, pipeline, std::move(err));
+    }
+    return env.Undefined();
+}
+
+Napi::Value FunctionWrapper::AddAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = function_->getAttributes();
+    if (llvm_nodejs::AddAttribute(info, 0, function_->getContext(), attributes,
+                                  llvm::AttributeList::FunctionIndex, nullptr)) {
+        function_->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value FunctionWrapper::RemoveAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = function_->getAttributes();
+    if (llvm_nodejs::RemoveAttribute(info, 0, function_->getContext(), attributes,
+                                     llvm::AttributeList::FunctionIndex)) {
+        function_->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value FunctionWrapper::HasAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
+    bool result = false;
+    if (!llvm_nodejs::HasAttribute(info, 0, function_->getAttributes(), llvm::AttributeList::FunctionIndex,
+                                   result)) {
+        return env.Undefined();
+    }
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value FunctionWrapper::AddReturnAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = function_->getAttributes();
+    if (llvm_nodejs::AddAttribute(info, 0, function_->getContext(), attributes,
+                                  llvm::AttributeList::ReturnIndex, function_->getReturnType())) {
+        function_->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value FunctionWrapper::RemoveReturnAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = function_->getAttributes();
+    if (llvm_nodejs::RemoveAttribute(info, 0, function_->getContext(), attributes,
+                                     llvm::AttributeList::ReturnIndex)) {
+        function_->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value FunctionWrapper::SetMemoryEffects(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::AttributeList attributes = function_->getAttributes();
+    if (llvm_nodejs::SetMemoryEffects(info, 0, function_->getContext(), attributes)) {
+        function_->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value FunctionWrapper::GetAttributes(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
+    return DescribeAttributes(env, function_->getAttributes(), function_->arg_size());
+}
+
+Napi::Value FunctionWrapper::GetLoopHints(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, function_, false)) {
+        return env.Undefined();
+    }
+    Napi::Array result = Napi::Array::New(env);
+    for (const llvm::BasicBlock& block : *function_) {
+        const llvm::Instruction* terminator = block.getTerminator();
+        if (terminator && terminator->getMetadata(llvm::LLVMContext::MD_loop)) {
+            Napi::Object hints = llvm_nodejs::GetLoopHints(env, terminator).As<Napi::Object>();
+            hints.Set("block", Napi::String::New(env, block.getName().str()));
+            result.Set(result.Length(), hints);
+        }
+    }
+    return result;
+}
+
 // ArgumentWrapper implementation
 ArgumentWrapper::ArgumentWrapper(const Napi::CallbackInfo& info)
     : Napi::ObjectWrap<ArgumentWrapper>(info) {
@@ -147,19 +342,27 @@ ArgumentWrapper::ArgumentWrapper(const Napi::CallbackInfo& info)
     if (info.Length() == 1 && info[0].IsExternal()) {
         argument_ = static_cast<llvm::Argument*>(
             info[0].As<Napi::External<llvm::Argument>>().Data());
+        handle_ = GetModuleHandle(argument_);
     } else {
         Napi::TypeError::New(env, "ArgumentWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
     }
 }
 
+llvm::Argument* ArgumentWrapper::GetArgument() const {
+    return handle_ && handle_->IsReleased() ? nullptr : argument_;
+}
+
 Napi::Object ArgumentWrapper::Init(Napi::Env env, Napi::Object exports) {
     Napi::Function func = DefineClass(env, "Argument", {
         InstanceMethod("getName", &ArgumentWrapper::GetName),
         InstanceMethod("setName", &ArgumentWrapper::SetName),
         InstanceMethod("getType", &ArgumentWrapper::GetType),
         InstanceMethod("getParent", &ArgumentWrapper::GetParent),
-        InstanceMethod("getArgNo", &ArgumentWrapper::GetArgNo)
+        InstanceMethod("getArgNo", &ArgumentWrapper::GetArgNo),
+        InstanceMethod("addAttribute", &ArgumentWrapper::AddAttribute),
+        InstanceMethod("removeAttribute", &ArgumentWrapper::RemoveAttribute),
+        InstanceMethod("hasAttribute", &ArgumentWrapper::HasAttribute)
     });
 
     constructor = Napi::Persistent(func);
@@ -176,6 +379,9 @@ Napi::Object ArgumentWrapper::Create(Napi::Env env, llvm::Argument* argument) {
 
 Napi::Value ArgumentWrapper::GetName(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, false)) {
+        return env.Undefined();
+    }
     if (argument_->hasName()) {
         return Napi::String::New(env, argument_->getName().str());
     }
@@ -184,6 +390,9 @@ Napi::Value ArgumentWrapper::GetName(const Napi::CallbackInfo& info) {
 
 Napi::Value ArgumentWrapper::SetName(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, true)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsString()) {
         Napi::TypeError::New(env, "Expected string argument").ThrowAsJavaScriptException();
@@ -198,19 +407,72 @@ Napi::Value ArgumentWrapper::SetName(const Napi::CallbackInfo& info) {
 
 Napi::Value ArgumentWrapper::GetType(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, false)) {
+        return env.Undefined();
+    }
     llvm::Type* type = argument_->getType();
     return TypeWrapper::Create(env, type);
 }
 
 Napi::Value ArgumentWrapper::GetParent(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, false)) {
+        return env.Undefined();
+    }
     llvm::Function* parent = argument_->getParent();
     return FunctionWrapper::Create(env, parent);
 }
 
 Napi::Value ArgumentWrapper::GetArgNo(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, false)) {
+        return env.Undefined();
+    }
     return Napi::Number::New(env, argument_->getArgNo());
 }
 
+Napi::Value ArgumentWrapper::AddAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::Function* function = argument_->getParent();
+    llvm::AttributeList attributes = function->getAttributes();
+    if (llvm_nodejs::AddAttribute(info, 0, function->getContext(), attributes,
+                                  llvm::AttributeList::FirstArgIndex + argument_->getArgNo(),
+                                  argument_->getType())) {
+        function->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value ArgumentWrapper::RemoveAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, true)) {
+        return env.Undefined();
+    }
+
+    llvm::Function* function = argument_->getParent();
+    llvm::AttributeList attributes = function->getAttributes();
+    if (llvm_nodejs::RemoveAttribute(info, 0, function->getContext(), attributes,
+                                     llvm::AttributeList::FirstArgIndex + argument_->getArgNo())) {
+        function->setAttributes(attributes);
+    }
+    return env.Undefined();
+}
+
+Napi::Value ArgumentWrapper::HasAttribute(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModuleIR(env, handle_, argument_, false)) {
+        return env.Undefined();
+    }
+    bool result = false;
+    if (!llvm_nodejs::HasAttribute(info, 0, argument_->getParent()->getAttributes(),
+                                   llvm::AttributeList::FirstArgIndex + argument_->getArgNo(), result)) {
+        return env.Undefined();
+    }
+    return Napi::Boolean::New(env, result);
+}
+
 }  // namespace llvm_nodejs
\ No newline at end of file
@@ -3,17 +3,21 @@
 #include <napi.h>
 #include <llvm/IR/IRBuilder.h>
 #include "llvm_types.h"
+#include <memory>
 
 namespace llvm_nodejs {
 
+struct ModuleHandle;
+
 class ArgumentWrapper : public Napi::ObjectWrap<ArgumentWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::Argument* argument);
     
     ArgumentWrapper(const Napi::CallbackInfo& info);
-    llvm::Argument* GetArgument() const { return argument_; }
+    // Null once the argument's module has been released
+    llvm::Argument* GetArgument() const;
     
     // Argument methods
     Napi::Value GetName(const Napi::CallbackInfo& info);
@@ -21,19 +25,24 @@ public:
     Napi::Value GetType(const Napi::CallbackInfo& info);
     Napi::Value GetParent(const Napi::CallbackInfo& info);
     Napi::Value GetArgNo(const Napi::CallbackInfo& info);
+    Napi::Value AddAttribute(const Napi::CallbackInfo& info);
+    Napi::Value RemoveAttribute(const Napi::CallbackInfo& info);
+    Napi::Value HasAttribute(const Napi::CallbackInfo& info);
     
 private:
     llvm::Argument* argument_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 class FunctionWrapper : public Napi::ObjectWrap<FunctionWrapper> {
 public:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object Create(Napi::Env env, llvm::Function* function);
     
     FunctionWrapper(const Napi::CallbackInfo& info);
-    llvm::Function* GetFunction() const { return function_; }
+    // Null once the function's module has been released
+    llvm::Function* GetFunction() const;
     
     // Function methods
     Napi::Value GetName(const Napi::CallbackInfo& info);
@@ -44,9 +53,26 @@ public:
     Napi::Value CreateBasicBlock(const Napi::CallbackInfo& info);
     Napi::Value GetBasicBlocks(const Napi::CallbackInfo& info);
     Napi::Value Dump(const Napi::CallbackInfo& info);
+    Napi::Value PrintTo(const Napi::CallbackInfo& info);
+    Napi::Value RunPasses(const Napi::CallbackInfo& info);
+
+    // Function and return value attributes; parameter attributes live on
+    // the Argument objects
+    Napi::Value AddAttribute(const Napi::CallbackInfo& info);
+    Napi::Value RemoveAttribute(const Napi::CallbackInfo& info);
+    Napi::Value HasAttribute(const Napi::CallbackInfo& info);
+    Napi::Value AddReturnAttribute(const Napi::CallbackInfo& info);
+    Napi::Value RemoveReturnAttribute(const Napi::CallbackInfo& info);
+    Napi::Value SetMemoryEffects(const Napi::CallbackInfo& info);
+    Napi::Value GetAttributes(const Napi::CallbackInfo& info);
+
+    // Hints of every loop in the function, e.g. to check what survived
+    // optimization
+    Napi::Value GetLoopHints(const Napi::CallbackInfo& info);
     
 private:
     llvm::Function* function_;
+    std::shared_ptr<ModuleHandle> handle_;
 };
 
 }  // namespace llvm_nodejs
\ No newline at end of file
@@ -0,0 +1,3169 @@
+#include "llvm_jit.h"
+#include "llvm_async.h"
+#include "llvm_module.h"
+#include "llvm_passes.h"
+#include "llvm_target.h"
+#include "llvm_types.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ObjectTransformLayer.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+
+namespace llvm_nodejs {
+
+// Every worker thread initializes the addon in an environment of its own
+thread_local Napi::FunctionReference JITEngineWrapper::constructor;
+thread_local Napi::FunctionReference JITModuleWrapper::constructor;
+
+//
+// JITSignature implementation
+//
+static bool KindFromType(llvm::Type* type, JITValueKind& kind) {
+    if (type->isVoidTy()) {
+        kind = JITValueKind::Void;
+    } else if (type->isIntegerTy(1)) {
+        kind = JITValueKind::Int1;
+    } else if (type->isIntegerTy(8)) {
+        kind = JITValueKind::Int8;
+    } else if (type->isIntegerTy(16)) {
+        kind = JITValueKind::Int16;
+    } else if (type->isIntegerTy(32)) {
+        kind = JITValueKind::Int32;
+    } else if (type->isIntegerTy(64)) {
+        kind = JITValueKind::Int64;
+    } else if (type->isFloatTy()) {
+        kind = JITValueKind::Float;
+    } else if (type->isDoubleTy()) {
+        kind = JITValueKind::Double;
+    } else if (type->isPointerTy()) {
+        kind = JITValueKind::Pointer;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char* KindName(JITValueKind kind) {
+    switch (kind) {
+    case JITValueKind::Void: return "void";
+    case JITValueKind::Int1: return "i1";
+    case JITValueKind::Int8: return "i8";
+    case JITValueKind::Int16: return "i16";
+    case JITValueKind::Int32: return "i32";
+    case JITValueKind::Int64: return "i64";
+    case JITValueKind::Float: return "float";
+    case JITValueKind::Double: return "double";
+    case JITValueKind::Pointer: return "ptr";
+    }
+    return "?";
+}
+
+bool JITSignature::FromFunctionType(llvm::FunctionType* type, JITSignature& signature) {
+    if (type->isVarArg() || !KindFromType(type->getReturnType(), signature.returnKind)) {
+        return false;
+    }
+
+    signature.paramKinds.clear();
+    signature.pointeeKinds.clear();
+    for (llvm::Type* paramType : type->params()) {
+        JITValueKind kind;
+        if (!KindFromType(paramType, kind) || kind == JITValueKind::Void) {
+            return false;
+        }
+        signature.paramKinds.push_back(kind);
+
+        JITValueKind pointeeKind = JITValueKind::Void;
+        if (paramType->isPointerTy() && !paramType->isOpaquePointerTy() &&
+            !KindFromType(paramType->getPointerElementType(), pointeeKind)) {
+            pointeeKind = JITValueKind::Void;
+        }
+        signature.pointeeKinds.push_back(pointeeKind);
+    }
+    return true;
+}
+
+std::string JITSignature::Mangle() const {
+    std::string str = KindName(returnKind);
+    str += "(";
+    for (size_t i = 0; i < paramKinds.size(); i++) {
+        if (i > 0) {
+            str += ",";
+        }
+        str += KindName(paramKinds[i]);
+    }
+    str += ")";
+    return str;
+}
+
+//
+// JITEngine implementation
+//
+// Names of the helper functions the engine generates itself
+static bool IsInternalName(llvm::StringRef name) {
+    return name.startswith("__llvm_nodejs_");
+}
+
+// Host function that tier 0 code calls once a function becomes hot
+static const char* const tierUpSymbolName = "__llvm_nodejs_tier_up";
+
+// Module flag holding the code generation level of a module
+static const char* const codeGenLevelFlag = "llvm_nodejs.codegen_opt_level";
+
+static const char* const tier0Suffix = ".tier0";
+static const char* const tier1Suffix = ".tier1";
+
+static llvm::CodeGenOpt::Level CodeGenLevelFromNumber(unsigned level) {
+    switch (level) {
+    case 0: return llvm::CodeGenOpt::None;
+    case 1: return llvm::CodeGenOpt::Less;
+    case 2: return llvm::CodeGenOpt::Default;
+    default: return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+// Compiles each module with the code generation level recorded in it, or
+// the engine default (-O0 for tiered engines, which also selects FastISel)
+class ModuleCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+public:
+    ModuleCompiler(llvm::orc::JITTargetMachineBuilder targetMachineBuilder, unsigned defaultLevel,
+                   llvm::ObjectCache* cache)
+        : IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(targetMachineBuilder.getOptions())),
+          targetMachineBuilder_(std::move(targetMachineBuilder)), defaultLevel_(defaultLevel),
+          cache_(cache) {}
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module& module) override {
+        unsigned level = defaultLevel_;
+        if (auto* flag = llvm::mdconst::extract_or_null<llvm::ConstantInt>(
+                module.getModuleFlag(codeGenLevelFlag))) {
+            level = static_cast<unsigned>(flag->getZExtValue());
+        } else if (cache_) {
+            // The level is part of the cache key
+            module.addModuleFlag(llvm::Module::Warning, codeGenLevelFlag, level);
+        }
+
+        // Tier 0 code embeds the addresses of this process' call counters
+        llvm::ObjectCache* cache = module.getFunction(tierUpSymbolName) ? nullptr : cache_;
+
+        // Target machines are not thread safe, so every compile gets its own
+        llvm::orc::JITTargetMachineBuilder targetMachineBuilder = targetMachineBuilder_;
+        targetMachineBuilder.setCodeGenOptLevel(CodeGenLevelFromNumber(level));
+        auto targetMachine = targetMachineBuilder.createTargetMachine();
+        if (!targetMachine) {
+            return targetMachine.takeError();
+        }
+        llvm::orc::SimpleCompiler compiler(**targetMachine, cache);
+        return compiler(module);
+    }
+
+private:
+    llvm::orc::JITTargetMachineBuilder targetMachineBuilder_;
+    unsigned defaultLevel_;
+    llvm::ObjectCache* cache_;
+};
+
+// Section memory manager that keeps the engine's live byte counters up to
+// date. The linking layer owns one per object and destroys it, freeing the
+// sections, when the object's resource tracker is removed.
+class CountingMemoryManager : public llvm::SectionMemoryManager {
+public:
+    explicit CountingMemoryManager(std::shared_ptr<JITMemoryCounters> counters)
+        : counters_(std::move(counters)), codeBytes_(0), dataBytes_(0) {}
+
+    ~CountingMemoryManager() override {
+        counters_->codeBytes -= codeBytes_;
+        counters_->dataBytes -= dataBytes_;
+    }
+
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment, unsigned sectionID,
+                                 llvm::StringRef sectionName) override {
+        codeBytes_ += size;
+        counters_->codeBytes += size;
+        return SectionMemoryManager::allocateCodeSection(size, alignment, sectionID, sectionName);
+    }
+
+    uint8_t* allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID,
+                                 llvm::StringRef sectionName, bool isReadOnly) override {
+        dataBytes_ += size;
+        counters_->dataBytes += size;
+        return SectionMemoryManager::allocateDataSection(size, alignment, sectionID, sectionName, isReadOnly);
+    }
+
+private:
+    std::shared_ptr<JITMemoryCounters> counters_;
+    int64_t codeBytes_;
+    int64_t dataBytes_;
+};
+
+JITModuleState::~JITModuleState() {
+    // Without an engine the JIT, and the code with it, is already gone
+    if (std::shared_ptr<JITEngine> engine = engine_.lock()) {
+        llvm::consumeError(engine->RemoveModule(*this));
+    }
+}
+
+JITEngine::JITEngine(std::unique_ptr<DiskObjectCache> cache, std::unique_ptr<llvm::orc::LLJIT> jit,
+                     const JITEngineOptions& options, llvm::orc::JITTargetMachineBuilder targetMachineBuilder,
+                     std::shared_ptr<JITMemoryCounters> memory)
+    : cache_(std::move(cache)), jit_(std::move(jit)), options_(options), targetMachineBuilder_(std::move(targetMachineBuilder)),
+      modulesAdded_(0), functionsAdded_(0), functionsMaterialized_(0), tierUps_(0),
+      tierUpFailures_(0), modulesUnloaded_(0), memory_(std::move(memory)) {
+    jit_->getIRTransformLayer().setTransform(
+        [this](llvm::orc::ThreadSafeModule module, llvm::orc::MaterializationResponsibility& responsibility) {
+            return TransformModule(std::move(module), responsibility);
+        });
+    if (options_.dedupe) {
+        jit_->getObjTransformLayer().setTransform(
+            [this](std::unique_ptr<llvm::MemoryBuffer> object) -> llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> {
+                RecordSymbolSizes(*object);
+                return object;
+            });
+    }
+}
+
+// Engines shared with other threads, by id
+static std::mutex sharedEnginesMutex;
+static std::map<uint64_t, std::weak_ptr<JITEngine>> sharedEngines;
+static uint64_t nextSharedEngineId = 1;
+
+JITEngine::~JITEngine() {
+    if (sharedId_) {
+        std::lock_guard<std::mutex> lock(sharedEnginesMutex);
+        sharedEngines.erase(sharedId_);
+    }
+
+    // Stop the background compiler before the JIT it compiles into goes away
+    if (tierUpThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(tierUpMutex_);
+            stopping_ = true;
+        }
+        tierUpCondition_.notify_all();
+        tierUpThread_.join();
+    }
+}
+
+llvm::Expected<std::shared_ptr<JITEngine>> JITEngine::Create(const JITEngineOptions& options) {
+    InitializeNativeTargetOnce();
+
+    auto targetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetMachineBuilder) {
+        return targetMachineBuilder.takeError();
+    }
+
+    std::unique_ptr<DiskObjectCache> cache;
+    if (!options.cacheDir.empty()) {
+        std::string configuration = targetMachineBuilder->getTargetTriple().str() + "|" +
+            targetMachineBuilder->getCPU() + "|" + targetMachineBuilder->getFeatures().getString();
+        auto diskCache = DiskObjectCache::Create(options.cacheDir, options.cacheMaxBytes, configuration);
+        if (!diskCache) {
+            return diskCache.takeError();
+        }
+        cache = std::move(*diskCache);
+    }
+
+    unsigned defaultLevel = options.tiered ? 0 : 2;
+    llvm::ObjectCache* objectCache = cache.get();
+    auto compileFunctionCreator = [defaultLevel, objectCache](llvm::orc::JITTargetMachineBuilder builder)
+        -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+        return std::make_unique<ModuleCompiler>(std::move(builder), defaultLevel, objectCache);
+    };
+
+    // Same linking layer LLJIT sets up by default, with memory managers that
+    // count the bytes they hold
+    auto memory = std::make_shared<JITMemoryCounters>();
+    auto objectLinkingLayerCreator = [memory](llvm::orc::ExecutionSession& session, const llvm::Triple& triple)
+        -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+        auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+            session, [memory]() { return std::make_unique<CountingMemoryManager>(memory); });
+        if (triple.isOSBinFormatCOFF()) {
+            layer->setOverrideObjectFlagsWithResponsibilityFlags(true);
+            layer->setAutoClaimResponsibilityForObjectSymbols(true);
+        }
+        return std::unique_ptr<llvm::orc::ObjectLayer>(std::move(layer));
+    };
+
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    if (options.lazy) {
+        // The compile-on-demand layer splits modules into per-function
+        // partitions and only compiles a partition once its stub is called
+        llvm::orc::LLLazyJITBuilder builder;
+        builder.setJITTargetMachineBuilder(*targetMachineBuilder);
+        builder.setNumCompileThreads(options.compileThreads);
+        builder.setCompileFunctionCreator(compileFunctionCreator);
+        builder.setObjectLinkingLayerCreator(objectLinkingLayerCreator);
+        auto lazyJit = builder.create();
+        if (!lazyJit) {
+            return lazyJit.takeError();
+        }
+        jit = std::move(*lazyJit);
+    } else {
+        llvm::orc::LLJITBuilder builder;
+        builder.setJITTargetMachineBuilder(*targetMachineBuilder);
+        builder.setNumCompileThreads(options.compileThreads);
+        builder.setCompileFunctionCreator(compileFunctionCreator);
+        builder.setObjectLinkingLayerCreator(objectLinkingLayerCreator);
+        auto eagerJit = builder.create();
+        if (!eagerJit) {
+            return eagerJit.takeError();
+        }
+        jit = std::move(*eagerJit);
+    }
+
+    std::shared_ptr<JITEngine> engine(
+        new JITEngine(std::move(cache), std::move(jit), options, std::move(*targetMachineBuilder),
+                      std::move(memory)));
+    if (options.tiered || options.redefinable) {
+        if (llvm::Error err = engine->SetUpTiering()) {
+            return err;
+        }
+    }
+    return engine;
+}
+
+llvm::Error JITEngine::SetUpTiering() {
+    stubs_ = llvm::orc::createLocalIndirectStubsManagerBuilder(jit_->getTargetTriple())();
+    if (!stubs_) {
+        return llvm::make_error<llvm::StringError>("Indirection stubs are not supported on this target",
+                                                   llvm::inconvertibleErrorCode());
+    }
+    // Redefinable engines only need the stubs
+    if (!options_.tiered) {
+        return llvm::Error::success();
+    }
+
+    llvm::orc::SymbolMap symbols;
+    symbols[jit_->mangleAndIntern(tierUpSymbolName)] = llvm::JITEvaluatedSymbol(
+        static_cast<llvm::JITTargetAddress>(reinterpret_cast<uintptr_t>(&JITEngine::ScheduleTierUp)),
+        llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    if (llvm::Error err = jit_->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+        return err;
+    }
+
+    tierUpThread_ = std::thread(&JITEngine::RunTierUpThread, this);
+    return llvm::Error::success();
+}
+
+// Bumps the call counter on entry and reports the function to the engine
+// exactly once, when the counter reaches the threshold
+void JITEngine::InsertCallCounter(llvm::Function& function, TieredFunction& tiered) {
+    llvm::LLVMContext& context = function.getContext();
+    llvm::BasicBlock* body = &function.getEntryBlock();
+    llvm::BasicBlock* count = llvm::BasicBlock::Create(context, "tier.count", &function, body);
+    llvm::BasicBlock* promote = llvm::BasicBlock::Create(context, "tier.promote", &function, body);
+
+    llvm::IRBuilder<> builder(count);
+    llvm::Value* counter = builder.CreateIntToPtr(
+        builder.getInt64(reinterpret_cast<uintptr_t>(&tiered.calls)), builder.getInt64Ty()->getPointerTo());
+    llvm::Value* previous = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter, builder.getInt64(1),
+                                                    llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+    llvm::Value* isHot = builder.CreateICmpEQ(
+        previous, builder.getInt64(std::max<uint64_t>(options_.tierUpThreshold, 1) - 1));
+    builder.CreateCondBr(isHot, promote, body, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    builder.SetInsertPoint(promote);
+    llvm::FunctionCallee tierUp = function.getParent()->getOrInsertFunction(
+        tierUpSymbolName, builder.getVoidTy(), builder.getInt8PtrTy());
+    builder.CreateCall(tierUp, {builder.CreateIntToPtr(
+        builder.getInt64(reinterpret_cast<uintptr_t>(&tiered)), builder.getInt8PtrTy())});
+    builder.CreateBr(body);
+}
+
+llvm::Error JITEngine::PrepareTiering(llvm::Module& module, JITModuleState& state,
+                                      std::vector<TieredFunction*>& functions) {
+    // Aliases would have to follow their aliasee into both tiers; keep such
+    // modules at tier 0
+    if (!module.alias_empty() || !module.ifunc_empty()) {
+        return llvm::Error::success();
+    }
+
+    // Both tiers of a function must see the same globals, so module local
+    // variables become uniquely named external ones
+    std::string localPrefix = "__llvm_nodejs_local." + std::to_string(modulesAdded_) + ".";
+    for (llvm::GlobalVariable& variable : module.globals()) {
+        if (variable.hasLocalLinkage()) {
+            variable.setName(localPrefix + variable.getName());
+            variable.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+    }
+
+    std::vector<llvm::Function*> bodies;
+    for (llvm::Function& function : module) {
+        if (!function.isDeclaration() && function.hasExternalLinkage() &&
+            !IsInternalName(function.getName())) {
+            bodies.push_back(&function);
+        }
+    }
+    if (bodies.empty()) {
+        return llvm::Error::success();
+    }
+
+    std::shared_ptr<std::string> bitcode;
+    if (options_.tiered) {
+        bitcode = std::make_shared<std::string>();
+        llvm::raw_string_ostream bitcodeStream(*bitcode);
+        llvm::WriteBitcodeToFile(module, bitcodeStream);
+        bitcodeStream.flush();
+    }
+
+    for (llvm::Function* body : bodies) {
+        std::string name = body->getName().str();
+        if (tieredFunctions_.count(name)) {
+            return llvm::make_error<llvm::StringError>("Duplicate definition of tiered function: " + name,
+                                                       llvm::inconvertibleErrorCode());
+        }
+
+        // Callers (including other modules and call wrappers) go through a
+        // stub named like the function; the body becomes the tier 0 target
+        body->setName(name + tier0Suffix);
+        llvm::Function* declaration = llvm::Function::Create(
+            body->getFunctionType(), llvm::Function::ExternalLinkage, name, &module);
+        declaration->setCallingConv(body->getCallingConv());
+        declaration->setAttributes(body->getAttributes());
+        body->replaceAllUsesWith(declaration);
+
+        auto tiered = std::make_shared<TieredFunction>();
+        tiered->engine = this;
+        tiered->name = name;
+        tiered->tracker = state.tracker_;
+        tiered->bitcode = bitcode;
+        llvm::raw_string_ostream typeStream(tiered->type);
+        body->getFunctionType()->print(typeStream);
+        typeStream.flush();
+        tiered->calls = 0;
+        tiered->tier = 0;
+        tiered->version = 0;
+        tiered->versionsBuilt = 0;
+        if (options_.tiered) {
+            InsertCallCounter(*body, *tiered);
+        }
+
+        // The stub of an unloaded function of the same name is still there;
+        // it points nowhere until PublishTier0 runs
+        if (stubs_->findStub(name, false)) {
+            if (llvm::Error err = stubs_->updatePointer(name, 0)) {
+                return err;
+            }
+        } else {
+            llvm::JITSymbolFlags flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+            if (llvm::Error err = stubs_->createStub(name, 0, flags)) {
+                return err;
+            }
+        }
+        llvm::orc::SymbolMap symbols;
+        symbols[jit_->mangleAndIntern(name)] = stubs_->findStub(name, true);
+        if (llvm::Error err = jit_->getMainJITDylib().define(
+                llvm::orc::absoluteSymbols(std::move(symbols)), state.tracker_)) {
+            return err;
+        }
+
+        functions.push_back(tiered.get());
+        tieredFunctions_[name] = std::move(tiered);
+    }
+    return llvm::Error::success();
+}
+
+void JITEngine::ScheduleTierUp(TieredFunction* function) {
+    JITEngine* engine = function->engine;
+    {
+        std::lock_guard<std::mutex> lock(engine->tierUpMutex_);
+        engine->tierUpQueue_.push_back(function->shared_from_this());
+    }
+    engine->tierUpCondition_.notify_one();
+}
+
+void JITEngine::RunTierUpThread() {
+    std::unique_lock<std::mutex> lock(tierUpMutex_);
+    while (true) {
+        tierUpCondition_.wait(lock, [this]() { return stopping_ || !tierUpQueue_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        std::shared_ptr<TieredFunction> function = std::move(tierUpQueue_.front());
+        tierUpQueue_.pop_front();
+        if (function->version != 0) {
+            continue;
+        }
+
+        lock.unlock();
+        if (llvm::Error err = TierUp(*function)) {
+            // The function simply stays at tier 0
+            llvm::consumeError(std::move(err));
+            tierUpFailures_++;
+        } else {
+            tierUps_++;
+        }
+        lock.lock();
+    }
+}
+
+llvm::Error JITEngine::TierUp(TieredFunction& function) {
+    // Rebuild the function from the saved bitcode in a fresh context so that
+    // optimizing it never touches IR the JIT may be compiling concurrently
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(*function.bitcode, function.name), *context);
+    if (!parsed) {
+        return parsed.takeError();
+    }
+    std::unique_ptr<llvm::Module> module = std::move(*parsed);
+
+    llvm::Function* target = module->getFunction(function.name);
+    if (!target || target->isDeclaration()) {
+        return llvm::make_error<llvm::StringError>("Tiered function vanished: " + function.name,
+                                                   llvm::inconvertibleErrorCode());
+    }
+
+    // Keep the hot function and the local helpers it may inline. Everything
+    // else resolves to the existing definitions, and calls to other tiered
+    // functions keep going through their stubs.
+    for (llvm::Function& other : *module) {
+        if (&other != target && !other.isDeclaration() && !other.hasLocalLinkage()) {
+            other.deleteBody();
+            other.setComdat(nullptr);
+        }
+    }
+    std::vector<llvm::GlobalVariable*> intrinsicVariables;
+    for (llvm::GlobalVariable& variable : module->globals()) {
+        if (variable.getName().startswith("llvm.")) {
+            intrinsicVariables.push_back(&variable);
+        } else if (!variable.isDeclaration()) {
+            variable.setInitializer(nullptr);
+            variable.setLinkage(llvm::GlobalValue::ExternalLinkage);
+            variable.setComdat(nullptr);
+        }
+    }
+    for (llvm::GlobalVariable* variable : intrinsicVariables) {
+        variable->eraseFromParent();
+    }
+    target->setName(function.name + tier1Suffix);
+
+    std::string errorStr;
+    llvm::raw_string_ostream errorStream(errorStr);
+    if (llvm::verifyModule(*module, &errorStream)) {
+        errorStream.flush();
+        return llvm::make_error<llvm::StringError>("Tier 1 module is invalid: " + errorStr,
+                                                   llvm::inconvertibleErrorCode());
+    }
+
+    auto targetMachine = targetMachineBuilder_.createTargetMachine();
+    if (!targetMachine) {
+        return targetMachine.takeError();
+    }
+    module->setDataLayout(jit_->getDataLayout());
+    OptimizationOptions optimizationOptions;
+    optimizationOptions.level = OptimizationLevelFromNumber(options_.tierUpOptLevel);
+    OptimizeModule(*module, optimizationOptions, targetMachine->get());
+    module->addModuleFlag(llvm::Module::Warning, codeGenLevelFlag, options_.tierUpOptLevel);
+
+    // ORC accepts code for a removed tracker and then fails to link it, so
+    // make sure the defining module stays loaded until the code is in
+    std::lock_guard<std::mutex> trackerLock(trackerMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tieredFunctions_.find(function.name);
+        if (it == tieredFunctions_.end() || it->second.get() != &function) {
+            return llvm::make_error<llvm::StringError>("Tiered function was unloaded: " + function.name,
+                                                       llvm::inconvertibleErrorCode());
+        }
+    }
+    if (llvm::Error err = jit_->addIRModule(
+            function.tracker, llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+        return err;
+    }
+    auto symbol = jit_->lookup(function.name + tier1Suffix);
+    if (!symbol) {
+        return symbol.takeError();
+    }
+
+    // Running tier 0 frames finish normally; new calls enter tier 1. The
+    // stub is looked up by name, so make sure it still belongs to us.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tieredFunctions_.find(function.name);
+    if (it == tieredFunctions_.end() || it->second.get() != &function) {
+        return llvm::make_error<llvm::StringError>("Tiered function was unloaded: " + function.name,
+                                                   llvm::inconvertibleErrorCode());
+    }
+    if (function.version != 0) {
+        return llvm::make_error<llvm::StringError>("Tiered function was redefined: " + function.name,
+                                                   llvm::inconvertibleErrorCode());
+    }
+    if (llvm::Error err = stubs_->updatePointer(function.name, symbol->getAddress())) {
+        return err;
+    }
+    function.tier = 1;
+    return llvm::Error::success();
+}
+
+llvm::Error JITEngine::Redefine(const std::string& name, llvm::orc::ThreadSafeModule module) {
+    std::shared_ptr<TieredFunction> function;
+    llvm::orc::ResourceTrackerSP tracker;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tieredFunctions_.find(name);
+        if (it == tieredFunctions_.end()) {
+            return llvm::make_error<llvm::StringError>(
+                "Function '" + name + "' is not defined behind a stub; create the engine with " +
+                "{ redefinable: true }", llvm::inconvertibleErrorCode());
+        }
+        function = it->second;
+        tracker = function->tracker;
+        version = ++function->versionsBuilt;
+    }
+
+    // Like a tier 1 body, the new one gets a name of its own and reaches
+    // itself and every other function through the stubs
+    std::string versionName = name + ".v" + std::to_string(version);
+    llvm::Error prepared = module.withModuleDo([&](llvm::Module& m) -> llvm::Error {
+        llvm::Function* body = m.getFunction(name);
+        if (!body || body->isDeclaration()) {
+            return llvm::make_error<llvm::StringError>("Module does not define '" + name + "'",
+                                                       llvm::inconvertibleErrorCode());
+        }
+        std::string type;
+        llvm::raw_string_ostream typeStream(type);
+        body->getFunctionType()->print(typeStream);
+        typeStream.flush();
+        if (type != function->type) {
+            return llvm::make_error<llvm::StringError>(
+                "New definition of '" + name + "' has type " + type + " instead of " + function->type,
+                llvm::inconvertibleErrorCode());
+        }
+        for (llvm::GlobalValue& global : m.global_values()) {
+            if (&global != body && !global.isDeclaration() && !global.hasLocalLinkage()) {
+                return llvm::make_error<llvm::StringError>(
+                    "Module redefining '" + name + "' also defines '" + global.getName().str() + "'",
+                    llvm::inconvertibleErrorCode());
+            }
+        }
+
+        body->setName(versionName);
+        llvm::Function* declaration = llvm::Function::Create(
+            body->getFunctionType(), llvm::Function::ExternalLinkage, name, &m);
+        declaration->setCallingConv(body->getCallingConv());
+        declaration->setAttributes(body->getAttributes());
+        body->replaceAllUsesWith(declaration);
+
+        // Tiered engines replace the function with optimized code right away
+        if (options_.tiered) {
+            auto targetMachine = targetMachineBuilder_.createTargetMachine();
+            if (!targetMachine) {
+                return targetMachine.takeError();
+            }
+            m.setDataLayout(jit_->getDataLayout());
+            OptimizationOptions optimizationOptions;
+            optimizationOptions.level = OptimizationLevelFromNumber(options_.tierUpOptLevel);
+            OptimizeModule(m, optimizationOptions, targetMachine->get());
+            m.addModuleFlag(llvm::Module::Warning, codeGenLevelFlag, options_.tierUpOptLevel);
+        }
+        return llvm::Error::success();
+    });
+    if (prepared) {
+        return prepared;
+    }
+
+    // Compiled without mutex_ so that calls and other modules are not held
+    // up; the code is freed together with the defining module, which has
+    // to stay loaded until the code is in (see TierUp)
+    std::lock_guard<std::mutex> trackerLock(trackerMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tieredFunctions_.find(name);
+        if (it == tieredFunctions_.end() || it->second != function) {
+            return llvm::make_error<llvm::StringError>("Function was unloaded while being redefined: " + name,
+                                                       llvm::inconvertibleErrorCode());
+        }
+    }
+    if (llvm::Error err = jit_->addIRModule(tracker, std::move(module))) {
+        return err;
+    }
+    auto symbol = jit_->lookup(versionName);
+    if (!symbol) {
+        return symbol.takeError();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tieredFunctions_.find(name);
+    if (it == tieredFunctions_.end() || it->second != function) {
+        return llvm::make_error<llvm::StringError>("Function was unloaded while being redefined: " + name,
+                                                   llvm::inconvertibleErrorCode());
+    }
+    // Of concurrent redefinitions the one started last wins
+    if (version < function->version) {
+        return llvm::Error::success();
+    }
+    if (llvm::Error err = stubs_->updatePointer(name, symbol->getAddress())) {
+        return err;
+    }
+    function->version = version;
+    if (options_.tiered) {
+        function->tier = 1;
+    }
+    return llvm::Error::success();
+}
+
+llvm::Expected<llvm::orc::ThreadSafeModule> JITEngine::TransformModule(
+    llvm::orc::ThreadSafeModule module, llvm::orc::MaterializationResponsibility&) {
+    module.withModuleDo([this](llvm::Module& m) {
+        for (llvm::Function& function : m) {
+            if (!function.isDeclaration() && !IsInternalName(function.getName())) {
+                functionsMaterialized_++;
+            }
+        }
+    });
+    return module;
+}
+
+// Name the function carries while its canonical text is printed
+static const char* const dedupeSelfName = "__llvm_nodejs_dedupe_self";
+
+// True if the constant refers to a global whose identity is private to its
+// module, so equal text would not mean equal code
+static bool RefersToModuleLocal(const llvm::Constant* constant) {
+    if (const auto* global = llvm::dyn_cast<llvm::GlobalValue>(constant)) {
+        return global->hasLocalLinkage() || !global->hasName();
+    }
+    for (const llvm::Use& operand : constant->operands()) {
+        if (RefersToModuleLocal(llvm::cast<llvm::Constant>(operand.get()))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// SHA-1 of the printed function with its own name and all local names
+// erased. The printer refers to attribute groups and metadata by module
+// specific numbers, so attributes are appended in full and functions with
+// metadata are not hashed at all. Local names are dropped for good, which
+// is fine for modules owned by the JIT.
+static bool StructuralFunctionHash(llvm::Function& function, std::string& hash) {
+    if (function.hasMetadata() || function.hasPrefixData() || function.hasPrologueData()) {
+        return false;
+    }
+
+    std::string attributes;
+    llvm::raw_string_ostream attributeStream(attributes);
+    function.getAttributes().print(attributeStream);
+    for (llvm::BasicBlock& block : function) {
+        for (llvm::Instruction& instruction : block) {
+            if (instruction.hasMetadata()) {
+                return false;
+            }
+            for (const llvm::Use& operand : instruction.operands()) {
+                const auto* constant = llvm::dyn_cast<llvm::Constant>(operand.get());
+                if (constant && constant != &function && RefersToModuleLocal(constant)) {
+                    return false;
+                }
+            }
+            if (const auto* call = llvm::dyn_cast<llvm::CallBase>(&instruction)) {
+                call->getAttributes().print(attributeStream);
+            }
+        }
+    }
+    attributeStream.flush();
+
+    for (llvm::Argument& argument : function.args()) {
+        argument.setName("");
+    }
+    for (llvm::BasicBlock& block : function) {
+        block.setName("");
+        for (llvm::Instruction& instruction : block) {
+            if (!instruction.getType()->isVoidTy()) {
+                instruction.setName("");
+            }
+        }
+    }
+
+    std::string name = function.getName().str();
+    std::string text;
+    llvm::raw_string_ostream textStream(text);
+    function.setName(dedupeSelfName);
+    function.print(textStream);
+    function.setName(name);
+    textStream.flush();
+
+    const llvm::Module* module = function.getParent();
+    llvm::SHA1 hasher;
+    hasher.update(module->getTargetTriple());
+    hasher.update("\n");
+    hasher.update(module->getDataLayoutStr());
+    hasher.update("\n");
+    hasher.update(attributes);
+    hasher.update(text);
+    hash = llvm::toHex(hasher.final(), true);
+    return true;
+}
+
+llvm::Expected<bool> JITEngine::DedupeFunctions(llvm::Module& module, JITModuleState& state,
+                                                std::map<std::string, std::string>& canonical) {
+    llvm::orc::SymbolAliasMap aliases;
+    std::vector<llvm::Function*> duplicates;
+    bool nothingLeft = module.global_empty() && module.alias_empty() && module.ifunc_empty();
+
+    for (llvm::Function& function : module) {
+        if (function.isDeclaration()) {
+            continue;
+        }
+        std::string hash;
+        if (!function.hasExternalLinkage() || IsInternalName(function.getName()) ||
+            !StructuralFunctionHash(function, hash)) {
+            nothingLeft = false;
+            continue;
+        }
+
+        // Duplicates within the module alias the first copy
+        auto it = dedupedFunctions_.find(hash);
+        if (it == dedupedFunctions_.end()) {
+            it = canonical.find(hash);
+            if (it == canonical.end()) {
+                canonical[hash] = function.getName().str();
+                nothingLeft = false;
+                std::lock_guard<std::mutex> lock(dedupeMutex_);
+                dedupeMisses_++;
+                continue;
+            }
+        }
+
+        aliases[jit_->mangleAndIntern(function.getName())] = llvm::orc::SymbolAliasMapEntry(
+            jit_->mangleAndIntern(it->second), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+        duplicates.push_back(&function);
+
+        // The canonical code has to stay loaded as long as the alias
+        auto owner = definingModules_.find(it->second);
+        std::shared_ptr<JITModuleState> canonical =
+            owner != definingModules_.end() ? owner->second.lock() : nullptr;
+        if (canonical && std::find(state.reused_.begin(), state.reused_.end(), canonical) == state.reused_.end()) {
+            canonical->reusedBy_++;
+            state.reused_.push_back(std::move(canonical));
+        }
+        std::lock_guard<std::mutex> lock(dedupeMutex_);
+        dedupeHitsByTarget_[it->second]++;
+    }
+
+    if (aliases.empty()) {
+        return nothingLeft;
+    }
+    if (llvm::Error err = jit_->getMainJITDylib().define(
+            llvm::orc::symbolAliases(std::move(aliases)), state.tracker_)) {
+        return err;
+    }
+
+    // Callers inside the module now reach the canonical code through the
+    // alias
+    for (llvm::Function* function : duplicates) {
+        function->deleteBody();
+    }
+    return nothingLeft;
+}
+
+void JITEngine::RecordSymbolSizes(const llvm::MemoryBuffer& object) {
+    auto file = llvm::object::ObjectFile::createObjectFile(object.getMemBufferRef());
+    if (!file) {
+        llvm::consumeError(file.takeError());
+        return;
+    }
+
+    char prefix = jit_->getDataLayout().getGlobalPrefix();
+    std::lock_guard<std::mutex> lock(dedupeMutex_);
+    for (const auto& symbolSize : llvm::object::computeSymbolSizes(**file)) {
+        auto type = symbolSize.first.getType();
+        auto name = symbolSize.first.getName();
+        if (!type || !name || *type != llvm::object::SymbolRef::ST_Function) {
+            if (!type) {
+                llvm::consumeError(type.takeError());
+            }
+            if (!name) {
+                llvm::consumeError(name.takeError());
+            }
+            continue;
+        }
+        llvm::StringRef symbolName = *name;
+        if (prefix && symbolName.startswith(llvm::StringRef(&prefix, 1))) {
+            symbolName = symbolName.drop_front();
+        }
+        symbolSizes_[symbolName.str()] = symbolSize.second;
+    }
+}
+
+llvm::Expected<std::shared_ptr<JITModuleState>> JITEngine::AddModule(llvm::orc::ThreadSafeModule module,
+                                                                     bool retain) {
+    // Declared before the lock so that modules dropped on failure are only
+    // released once mutex_ is unlocked
+    std::vector<std::shared_ptr<JITModuleState>> released;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<TieredFunction*> tiered;
+    auto state = AddModuleLocked(std::move(module), retain, tiered, released);
+    if (!state) {
+        return state.takeError();
+    }
+    if (llvm::Error err = PublishTier0(tiered)) {
+        released.push_back(std::move(*state));
+        return err;
+    }
+    return state;
+}
+
+llvm::Expected<std::vector<std::shared_ptr<JITModuleState>>> JITEngine::AddModules(
+    std::vector<llvm::orc::ThreadSafeModule> modules, bool retain) {
+    // Declared before the lock so that modules dropped on failure are only
+    // released once mutex_ is unlocked
+    std::vector<std::shared_ptr<JITModuleState>> states;
+    std::vector<std::shared_ptr<JITModuleState>> released;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<std::string> names;
+    std::vector<TieredFunction*> tiered;
+    for (llvm::orc::ThreadSafeModule& module : modules) {
+        auto state = AddModuleLocked(std::move(module), retain, tiered, released);
+        if (!state) {
+            return state.takeError();
+        }
+        names.insert(names.end(), (*state)->names_.begin(), (*state)->names_.end());
+        states.push_back(std::move(*state));
+    }
+
+    // Tiered engines compile tier 0 while publishing it
+    if (options_.tiered) {
+        if (llvm::Error err = PublishTier0(tiered)) {
+            return err;
+        }
+    } else if (!options_.lazy) {
+        if (llvm::Error err = Materialize(names)) {
+            return err;
+        }
+    }
+    return states;
+}
+
+// Round-trips the module through bitcode into a fresh context, so that
+// compiling it on another thread never touches the context of its creator
+static llvm::Expected<llvm::orc::ThreadSafeModule> MoveToPrivateContext(llvm::orc::ThreadSafeModule module) {
+    std::string bitcode;
+    std::string identifier;
+    module.withModuleDo([&bitcode, &identifier](llvm::Module& m) {
+        llvm::raw_string_ostream bitcodeStream(bitcode);
+        llvm::WriteBitcodeToFile(m, bitcodeStream);
+        bitcodeStream.flush();
+        identifier = m.getModuleIdentifier();
+    });
+    module = llvm::orc::ThreadSafeModule();
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, identifier), *context);
+    if (!parsed) {
+        return parsed.takeError();
+    }
+    return llvm::orc::ThreadSafeModule(std::move(*parsed), std::move(context));
+}
+
+llvm::Expected<std::shared_ptr<JITModuleState>> JITEngine::AddModuleLocked(
+    llvm::orc::ThreadSafeModule module, bool retain, std::vector<TieredFunction*>& tiered,
+    std::vector<std::shared_ptr<JITModuleState>>& released) {
+    // See Share()
+    if (options_.lazy || shared_) {
+        auto moved = MoveToPrivateContext(std::move(module));
+        if (!moved) {
+            return moved.takeError();
+        }
+        module = std::move(*moved);
+    }
+
+    auto state = std::make_shared<JITModuleState>();
+    state->engine_ = shared_from_this();
+    state->tracker_ = jit_->getMainJITDylib().createResourceTracker();
+
+    // Remember the signatures of the definitions so that callers do not need
+    // to pass the function type again once the IR is gone
+    module.withModuleDo([this, &state](llvm::Module& m) {
+        for (llvm::GlobalValue& global : m.global_values()) {
+            if (!global.isDeclaration() && !global.hasLocalLinkage()) {
+                state->names_.push_back(global.getName().str());
+            }
+        }
+        for (llvm::Function& function : m) {
+            if (function.isDeclaration()) {
+                continue;
+            }
+            functionsAdded_++;
+
+            JITSignature signature;
+            if (!function.hasLocalLinkage() &&
+                JITSignature::FromFunctionType(function.getFunctionType(), signature)) {
+                signatures_[function.getName().str()] = signature;
+            }
+        }
+    });
+
+    // Anything defined under the tracker before a failure goes away with it.
+    // The state and the modules it reused are released by the caller once
+    // mutex_ is unlocked, as their destructors take it.
+    auto fail = [this, &state, &released](llvm::Error err) -> llvm::Error {
+        llvm::consumeError(state->tracker_->remove());
+        if (state->lazyDylib_) {
+            if (llvm::Error err = ClearLazyDylib(*state->lazyDylib_)) {
+                llvm::consumeError(std::move(err));
+            } else {
+                freeLazyDylibs_.push_back(state->lazyDylib_);
+            }
+        }
+        state->loaded_ = false;
+        for (auto it = tieredFunctions_.begin(); it != tieredFunctions_.end();) {
+            if (it->second->tracker == state->tracker_) {
+                it = tieredFunctions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (std::shared_ptr<JITModuleState>& other : state->reused_) {
+            other->reusedBy_--;
+            released.push_back(std::move(other));
+        }
+        state->reused_.clear();
+        released.push_back(state);
+        return err;
+    };
+
+    // Instrument first so that every tier, and batch loops inlining the
+    // function, bump the same counters. Lazy modules only reexport names_,
+    // so the counters are listed there too.
+    if (options_.instrument) {
+        std::string counterPrefix = "__llvm_nodejs_prof." + std::to_string(modulesAdded_) + ".";
+        state->profile_ = module.withModuleDo([&counterPrefix](llvm::Module& m) {
+            return InstrumentModule(m, counterPrefix);
+        });
+        for (const ProfileLayout& layout : state->profile_) {
+            state->names_.push_back(layout.counters);
+        }
+        profiledModules_.push_back(state);
+    }
+
+    if (options_.batchInlining && !options_.redefinable) {
+        module.withModuleDo([this](llvm::Module& m) { RecordBatchCallees(m); });
+    }
+
+    // Only known to other modules once this one has been added
+    std::map<std::string, std::string> canonical;
+    bool nothingLeft = false;
+    if (options_.tiered || options_.redefinable) {
+        llvm::Error err = module.withModuleDo([this, &state, &tiered](llvm::Module& m) {
+            return PrepareTiering(m, *state, tiered);
+        });
+        if (err) {
+            return fail(std::move(err));
+        }
+    } else if (options_.dedupe) {
+        auto deduped = module.withModuleDo([this, &state, &canonical](llvm::Module& m) {
+            return DedupeFunctions(m, *state, canonical);
+        });
+        if (!deduped) {
+            return fail(deduped.takeError());
+        }
+        // A module made up entirely of known functions is not compiled at all
+        nothingLeft = *deduped;
+    }
+
+    if (!nothingLeft) {
+        llvm::Error err = options_.lazy ? AddLazyModule(std::move(module), *state)
+                                        : jit_->addIRModule(state->tracker_, std::move(module));
+        if (err) {
+            return fail(std::move(err));
+        }
+    }
+    modulesAdded_++;
+
+    dedupedFunctions_.insert(canonical.begin(), canonical.end());
+    for (const std::string& name : state->names_) {
+        definingModules_[name] = state;
+    }
+    if (retain) {
+        retainedModules_.insert(state);
+    }
+    return state;
+}
+
+llvm::Error JITEngine::PublishTier0(const std::vector<TieredFunction*>& tiered) {
+    if (tiered.empty()) {
+        return llvm::Error::success();
+    }
+
+    std::vector<std::string> names;
+    for (TieredFunction* function : tiered) {
+        names.push_back(function->name + tier0Suffix);
+    }
+    auto symbols = Lookup(names);
+    if (!symbols) {
+        return symbols.takeError();
+    }
+
+    // Point the stubs at tier 0. In lazy mode this only resolves the lazy
+    // reexports, so nothing is compiled before the first call.
+    for (TieredFunction* function : tiered) {
+        llvm::JITTargetAddress address =
+            (*symbols)[jit_->mangleAndIntern(function->name + tier0Suffix)].getAddress();
+        if (llvm::Error err = stubs_->updatePointer(function->name, address)) {
+            return err;
+        }
+    }
+    return llvm::Error::success();
+}
+
+llvm::Expected<llvm::orc::SymbolMap> JITEngine::Lookup(const std::vector<std::string>& names) {
+    llvm::orc::SymbolLookupSet symbols;
+    for (const std::string& name : names) {
+        symbols.add(jit_->mangleAndIntern(name));
+    }
+
+    // A single query lets ORC compile the definitions concurrently when it
+    // has compile threads
+    return jit_->getExecutionSession().lookup(
+        llvm::orc::makeJITDylibSearchOrder(&jit_->getMainJITDylib()), std::move(symbols));
+}
+
+llvm::Error JITEngine::Unload(const std::shared_ptr<JITModuleState>& module) {
+    // Released after the removal, which has already happened by then
+    std::shared_ptr<JITModuleState> retained;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (module->reusedBy_ > 0) {
+            return llvm::make_error<llvm::StringError>(
+                "Module code is reused by " + std::to_string(module->reusedBy_) + " other modules",
+                llvm::inconvertibleErrorCode());
+        }
+        auto it = retainedModules_.find(module);
+        if (it != retainedModules_.end()) {
+            retained = *it;
+            retainedModules_.erase(it);
+        }
+    }
+    return RemoveModule(*module);
+}
+
+llvm::Error JITEngine::RemoveModule(JITModuleState& module) {
+    std::vector<std::shared_ptr<JITModuleState>> reused;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!module.loaded_) {
+            return llvm::Error::success();
+        }
+        module.loaded_ = false;
+        modulesUnloaded_++;
+
+        for (const std::string& name : module.names_) {
+            signatures_.erase(name);
+            definingModules_.erase(name);
+            batchCallees_.erase(name);
+
+            tieredFunctions_.erase(name);
+        }
+        for (const std::string& key : module.wrapperKeys_) {
+            wrappers_.erase(key);
+            batchLoops_.erase(key);
+        }
+        for (auto it = dedupedFunctions_.begin(); it != dedupedFunctions_.end();) {
+            if (std::find(module.names_.begin(), module.names_.end(), it->second) != module.names_.end()) {
+                it = dedupedFunctions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        for (const std::shared_ptr<JITModuleState>& other : module.reused_) {
+            other->reusedBy_--;
+        }
+        reused.swap(module.reused_);
+    }
+
+    // Releasing the reused modules may remove them in turn, which takes
+    // mutex_ again
+    std::unique_lock<std::mutex> trackerLock(trackerMutex_);
+    llvm::Error err = module.tracker_->remove();
+    trackerLock.unlock();
+    if (module.lazyDylib_) {
+        if (llvm::Error clearErr = ClearLazyDylib(*module.lazyDylib_)) {
+            err = llvm::joinErrors(std::move(err), std::move(clearErr));
+        } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            freeLazyDylibs_.push_back(module.lazyDylib_);
+        }
+    }
+    reused.clear();
+    return err;
+}
+
+llvm::Error JITEngine::AddLazyModule(llvm::orc::ThreadSafeModule module, JITModuleState& state) {
+    llvm::orc::SymbolAliasMap reexports;
+    module.withModuleDo([this, &reexports](llvm::Module& m) {
+        // Like LLLazyJIT::addLazyIRModule
+        if (m.getDataLayout().isDefault()) {
+            m.setDataLayout(jit_->getDataLayout());
+        }
+        for (llvm::GlobalValue& global : m.global_values()) {
+            if (!global.isDeclaration() && !global.hasLocalLinkage()) {
+                llvm::orc::SymbolStringPtr name = jit_->mangleAndIntern(global.getName());
+                reexports[name] = llvm::orc::SymbolAliasMapEntry(
+                    name, llvm::JITSymbolFlags::fromGlobalValue(global));
+            }
+        }
+    });
+
+    llvm::orc::JITDylib* dylib;
+    if (!freeLazyDylibs_.empty()) {
+        dylib = freeLazyDylibs_.back();
+        freeLazyDylibs_.pop_back();
+    } else {
+        dylib = &jit_->getExecutionSession().createBareJITDylib(
+            "__llvm_nodejs_lazy." + std::to_string(lazyDylibsCreated_++));
+        // Resolve everything else like code in the main dylib does
+        llvm::orc::JITDylibSearchOrder linkOrder;
+        linkOrder.push_back({dylib, llvm::orc::JITDylibLookupFlags::MatchAllSymbols});
+        jit_->getMainJITDylib().withLinkOrderDo([&linkOrder](const llvm::orc::JITDylibSearchOrder& mainOrder) {
+            linkOrder.insert(linkOrder.end(), mainOrder.begin(), mainOrder.end());
+        });
+        dylib->setLinkOrder(std::move(linkOrder), false);
+    }
+    state.lazyDylib_ = dylib;
+
+    auto& lazyJit = static_cast<llvm::orc::LLLazyJIT&>(*jit_);
+    if (llvm::Error err = lazyJit.getCompileOnDemandLayer().add(*dylib, std::move(module))) {
+        return err;
+    }
+    return jit_->getMainJITDylib().define(llvm::orc::reexports(*dylib, std::move(reexports)), state.tracker_);
+}
+
+llvm::Error JITEngine::ClearLazyDylib(llvm::orc::JITDylib& dylib) {
+    llvm::Error err = dylib.clear();
+    if (llvm::orc::JITDylib* implementation =
+            jit_->getExecutionSession().getJITDylibByName(dylib.getName() + ".impl")) {
+        err = llvm::joinErrors(std::move(err), implementation->clear());
+    }
+    return err;
+}
+
+std::shared_ptr<JITModuleState> JITEngine::GetDefiningModule(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = definingModules_.find(name);
+    if (it == definingModules_.end()) {
+        return nullptr;
+    }
+    return it->second.lock();
+}
+
+llvm::Error JITEngine::Materialize(const std::vector<std::string>& names) {
+    auto symbols = Lookup(names);
+    if (!symbols) {
+        return symbols.takeError();
+    }
+    return llvm::Error::success();
+}
+
+JITEngineStats JITEngine::GetStats() const {
+    JITEngineStats stats;
+    stats.modulesAdded = modulesAdded_;
+    stats.functionsAdded = functionsAdded_;
+    stats.functionsMaterialized = functionsMaterialized_;
+    stats.tierUps = tierUps_;
+    stats.tierUpFailures = tierUpFailures_;
+    stats.modulesUnloaded = modulesUnloaded_;
+    stats.liveCodeBytes = static_cast<uint64_t>(std::max<int64_t>(memory_->codeBytes, 0));
+    stats.liveDataBytes = static_cast<uint64_t>(std::max<int64_t>(memory_->dataBytes, 0));
+    ObjectCacheStats cacheStats = cache_ ? cache_->GetStats() : ObjectCacheStats{0, 0, 0};
+    stats.cacheHits = cacheStats.hits;
+    stats.cacheMisses = cacheStats.misses;
+    stats.cacheEvictions = cacheStats.evictions;
+
+    std::lock_guard<std::mutex> lock(dedupeMutex_);
+    stats.dedupeHits = 0;
+    stats.dedupeMisses = dedupeMisses_;
+    stats.dedupeBytesSaved = 0;
+    for (const auto& target : dedupeHitsByTarget_) {
+        stats.dedupeHits += target.second;
+        auto size = symbolSizes_.find(target.first);
+        if (size != symbolSizes_.end()) {
+            stats.dedupeBytesSaved += target.second * size->second;
+        }
+    }
+    return stats;
+}
+
+llvm::Expected<std::vector<std::pair<ProfileLayout, uint64_t*>>> JITEngine::GetProfileCounters() {
+    std::vector<ProfileLayout> layouts;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = profiledModules_.begin(); it != profiledModules_.end();) {
+            std::shared_ptr<JITModuleState> module = it->lock();
+            if (!module || !module->IsLoaded()) {
+                it = profiledModules_.erase(it);
+                continue;
+            }
+            layouts.insert(layouts.end(), module->profile_.begin(), module->profile_.end());
+            ++it;
+        }
+    }
+
+    std::vector<std::pair<ProfileLayout, uint64_t*>> counters;
+    if (layouts.empty()) {
+        return counters;
+    }
+    std::vector<std::string> names;
+    for (const ProfileLayout& layout : layouts) {
+        names.push_back(layout.counters);
+    }
+    auto symbols = Lookup(names);
+    if (!symbols) {
+        return symbols.takeError();
+    }
+    for (ProfileLayout& layout : layouts) {
+        uint64_t* address = llvm::jitTargetAddressToPointer<uint64_t*>(
+            (*symbols)[jit_->mangleAndIntern(layout.counters)].getAddress());
+        counters.emplace_back(std::move(layout), address);
+    }
+    return counters;
+}
+
+llvm::Expected<ModuleProfile> JITEngine::GetProfile() {
+    auto counters = GetProfileCounters();
+    if (!counters) {
+        return counters.takeError();
+    }
+    ModuleProfile profile;
+    for (const auto& entry : *counters) {
+        profile[entry.first.function] = ReadProfileCounters(entry.first, entry.second);
+    }
+    return profile;
+}
+
+llvm::Error JITEngine::ResetProfile() {
+    auto counters = GetProfileCounters();
+    if (!counters) {
+        return counters.takeError();
+    }
+    for (const auto& entry : *counters) {
+        size_t count = 1;
+        for (unsigned successors : entry.first.branches) {
+            count += successors;
+        }
+        std::fill(entry.second, entry.second + count, 0);
+    }
+    return llvm::Error::success();
+}
+
+llvm::Expected<uint64_t> JITEngine::Share() {
+    // Modules added from now on get a context of their own; the ones added
+    // so far compile here, in the context of this thread
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!shared_ && !options_.lazy) {
+            for (const auto& entry : definingModules_) {
+                pending.push_back(entry.first);
+            }
+        }
+        shared_ = true;
+    }
+    if (llvm::Error err = Materialize(pending)) {
+        return err;
+    }
+
+    std::lock_guard<std::mutex> lock(sharedEnginesMutex);
+    if (!sharedId_) {
+        sharedId_ = nextSharedEngineId++;
+        sharedEngines[sharedId_] = shared_from_this();
+    }
+    return sharedId_;
+}
+
+std::shared_ptr<JITEngine> JITEngine::FromShared(uint64_t id) {
+    std::lock_guard<std::mutex> lock(sharedEnginesMutex);
+    auto it = sharedEngines.find(id);
+    return it != sharedEngines.end() ? it->second.lock() : nullptr;
+}
+
+bool JITEngine::GetTierInfo(const std::string& name, JITTierInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tieredFunctions_.find(name);
+    if (it == tieredFunctions_.end()) {
+        return false;
+    }
+    info.tier = it->second->tier;
+    info.calls = it->second->calls;
+    return true;
+}
+
+bool JITEngine::GetSignature(const std::string& name, JITSignature& signature) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = signatures_.find(name);
+    if (it == signatures_.end()) {
+        return false;
+    }
+    signature = it->second;
+    return true;
+}
+
+static llvm::Type* TypeFromKind(llvm::LLVMContext& context, JITValueKind kind) {
+    switch (kind) {
+    case JITValueKind::Void: return llvm::Type::getVoidTy(context);
+    case JITValueKind::Int1: return llvm::Type::getInt1Ty(context);
+    case JITValueKind::Int8: return llvm::Type::getInt8Ty(context);
+    case JITValueKind::Int16: return llvm::Type::getInt16Ty(context);
+    case JITValueKind::Int32: return llvm::Type::getInt32Ty(context);
+    case JITValueKind::Int64: return llvm::Type::getInt64Ty(context);
+    case JITValueKind::Float: return llvm::Type::getFloatTy(context);
+    case JITValueKind::Double: return llvm::Type::getDoubleTy(context);
+    case JITValueKind::Pointer: return llvm::Type::getInt8PtrTy(context);
+    }
+    return nullptr;
+}
+
+// Converts the raw 64-bit slot into a value of the parameter type
+static llvm::Value* LoadSlotValue(llvm::IRBuilder<>& builder, llvm::Value* slot,
+                                  JITValueKind kind, llvm::Type* type) {
+    switch (kind) {
+    case JITValueKind::Int1:
+    case JITValueKind::Int8:
+    case JITValueKind::Int16:
+    case JITValueKind::Int32:
+        return builder.CreateTrunc(slot, type);
+    case JITValueKind::Float:
+        return builder.CreateFPTrunc(builder.CreateBitCast(slot, builder.getDoubleTy()), type);
+    case JITValueKind::Double:
+        return builder.CreateBitCast(slot, type);
+    case JITValueKind::Pointer:
+        return builder.CreateIntToPtr(slot, type);
+    default:
+        return slot;
+    }
+}
+
+// Widens a return value into the raw 64-bit slot representation
+static llvm::Value* StoreSlotValue(llvm::IRBuilder<>& builder, llvm::Value* value,
+                                   JITValueKind kind) {
+    switch (kind) {
+    case JITValueKind::Int1:
+        return builder.CreateZExt(value, builder.getInt64Ty());
+    case JITValueKind::Int8:
+    case JITValueKind::Int16:
+    case JITValueKind::Int32:
+        return builder.CreateSExt(value, builder.getInt64Ty());
+    case JITValueKind::Float:
+        return builder.CreateBitCast(builder.CreateFPExt(value, builder.getDoubleTy()),
+                                     builder.getInt64Ty());
+    case JITValueKind::Double:
+        return builder.CreateBitCast(value, builder.getInt64Ty());
+    case JITValueKind::Pointer:
+        return builder.CreatePtrToInt(value, builder.getInt64Ty());
+    default:
+        return value;
+    }
+}
+
+llvm::orc::ThreadSafeModule JITEngine::BuildCallWrapper(const std::string& name,
+                                                        const std::string& wrapperName,
+                                                        const JITSignature& signature) {
+    // The wrapper lives in its own context so that it never contends with
+    // the context of the module that defines the target
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = std::make_unique<llvm::Module>(wrapperName, *context);
+    module->setDataLayout(jit_->getDataLayout());
+    module->setTargetTriple(jit_->getTargetTriple().str());
+
+    std::vector<llvm::Type*> paramTypes;
+    for (JITValueKind kind : signature.paramKinds) {
+        paramTypes.push_back(TypeFromKind(*context, kind));
+    }
+    llvm::FunctionType* targetType = llvm::FunctionType::get(
+        TypeFromKind(*context, signature.returnKind), paramTypes, false);
+    llvm::Function* target = llvm::Function::Create(
+        targetType, llvm::Function::ExternalLinkage, name, module.get());
+
+    llvm::Type* slotPtrType = llvm::Type::getInt64PtrTy(*context);
+    llvm::FunctionType* wrapperType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(*context), {slotPtrType, slotPtrType}, false);
+    llvm::Function* wrapper = llvm::Function::Create(
+        wrapperType, llvm::Function::ExternalLinkage, wrapperName, module.get());
+
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(*context, "entry", wrapper));
+    llvm::Value* argSlots = wrapper->getArg(0);
+    llvm::Value* retSlot = wrapper->getArg(1);
+
+    std::vector<llvm::Value*> callArgs;
+    for (unsigned i = 0; i < paramTypes.size(); i++) {
+        llvm::Value* slotPtr = builder.CreateConstInBoundsGEP1_64(builder.getInt64Ty(), argSlots, i);
+        llvm::Value* slot = builder.CreateLoad(builder.getInt64Ty(), slotPtr);
+        callArgs.push_back(LoadSlotValue(builder, slot, signature.paramKinds[i], paramTypes[i]));
+    }
+
+    llvm::CallInst* call = builder.CreateCall(target, callArgs);
+    if (signature.returnKind != JITValueKind::Void) {
+        builder.CreateStore(StoreSlotValue(builder, call, signature.returnKind), retSlot);
+    }
+    builder.CreateRetVoid();
+
+    return llvm::orc::ThreadSafeModule(std::move(module), std::move(context));
+}
+
+llvm::Expected<llvm::JITTargetAddress> JITEngine::GetFunctionAddress(const std::string& name) {
+    auto symbols = Lookup({name});
+    if (!symbols) {
+        return symbols.takeError();
+    }
+    return (*symbols)[jit_->mangleAndIntern(name)].getAddress();
+}
+
+llvm::Expected<JITCallWrapper> JITEngine::GetCallWrapper(const std::string& name,
+                                                         const JITSignature& signature) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string key = name + ":" + signature.Mangle();
+    auto it = wrappers_.find(key);
+    if (it != wrappers_.end()) {
+        return it->second;
+    }
+
+    // The wrapper is removed together with the module defining its target
+    auto owner = definingModules_.find(name);
+    std::shared_ptr<JITModuleState> module = owner != definingModules_.end() ? owner->second.lock() : nullptr;
+    llvm::orc::ResourceTrackerSP tracker =
+        module ? module->tracker_ : jit_->getMainJITDylib().getDefaultResourceTracker();
+
+    std::string wrapperName = "__llvm_nodejs_call." + std::to_string(wrappersBuilt_++);
+    if (llvm::Error err = jit_->addIRModule(tracker, BuildCallWrapper(name, wrapperName, signature))) {
+        return err;
+    }
+
+    // Looking the wrapper up compiles it together with everything it calls
+    auto symbol = jit_->lookup(wrapperName);
+    if (!symbol) {
+        return symbol.takeError();
+    }
+
+    JITCallWrapper wrapper = reinterpret_cast<JITCallWrapper>(
+        static_cast<uintptr_t>(symbol->getAddress()));
+    wrappers_[key] = wrapper;
+    if (module) {
+        module->wrapperKeys_.push_back(key);
+    }
+    return wrapper;
+}
+
+// Kinds a batch column can hold
+static bool IsBatchKind(JITValueKind kind) {
+    switch (kind) {
+    case JITValueKind::Int8:
+    case JITValueKind::Int16:
+    case JITValueKind::Int32:
+    case JITValueKind::Int64:
+    case JITValueKind::Float:
+    case JITValueKind::Double:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool IsBatchSignature(const JITSignature& signature, JITBatchKind kind) {
+    if (!IsBatchKind(signature.returnKind) ||
+        !std::all_of(signature.paramKinds.begin(), signature.paramKinds.end(), IsBatchKind)) {
+        return false;
+    }
+    // Reductions fold the result back into the first parameter
+    return kind == JITBatchKind::Map ||
+        (signature.paramKinds.size() >= 2 && signature.paramKinds[0] == signature.returnKind);
+}
+
+// Small functions that only compute on their arguments, so that a copy can
+// be inlined anywhere
+static bool IsBatchInlineCandidate(const llvm::Function& function) {
+    JITSignature signature;
+    if (function.isDeclaration() || !function.hasExternalLinkage() || IsInternalName(function.getName()) ||
+        !JITSignature::FromFunctionType(function.getFunctionType(), signature) ||
+        !IsBatchSignature(signature, JITBatchKind::Map) || function.getInstructionCount() > 64) {
+        return false;
+    }
+    for (const llvm::BasicBlock& block : function) {
+        for (const llvm::Instruction& instruction : block) {
+            for (const llvm::Use& operand : instruction.operands()) {
+                const auto* global = llvm::dyn_cast<llvm::GlobalValue>(operand.get());
+                if (global && !(llvm::isa<llvm::Function>(global) &&
+                                llvm::cast<llvm::Function>(global)->isIntrinsic())) {
+                    return false;
+                }
+                if (llvm::isa<llvm::ConstantExpr>(operand.get())) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void JITEngine::RecordBatchCallees(llvm::Module& module) {
+    std::set<const llvm::GlobalValue*> candidates;
+    for (llvm::Function& function : module) {
+        if (IsBatchInlineCandidate(function)) {
+            candidates.insert(&function);
+        }
+    }
+    if (candidates.empty()) {
+        return;
+    }
+
+    // One bitcode copy of all candidates of the module, without anything
+    // else they could drag along
+    llvm::ValueToValueMapTy valueMap;
+    std::unique_ptr<llvm::Module> copy = llvm::CloneModule(
+        module, valueMap, [&candidates](const llvm::GlobalValue* global) { return candidates.count(global) > 0; });
+    while (!copy->alias_empty()) {
+        copy->alias_begin()->eraseFromParent();
+    }
+    while (!copy->global_empty()) {
+        llvm::GlobalVariable& variable = *copy->global_begin();
+        variable.replaceAllUsesWith(llvm::UndefValue::get(variable.getType()));
+        variable.eraseFromParent();
+    }
+    for (auto it = copy->begin(); it != copy->end();) {
+        llvm::Function& function = *it++;
+        if (function.isDeclaration() && function.use_empty()) {
+            function.eraseFromParent();
+        }
+    }
+
+    auto bitcode = std::make_shared<std::string>();
+    llvm::raw_string_ostream bitcodeStream(*bitcode);
+    llvm::WriteBitcodeToFile(*copy, bitcodeStream);
+    bitcodeStream.flush();
+    for (const llvm::GlobalValue* candidate : candidates) {
+        batchCallees_[candidate->getName().str()] = bitcode;
+    }
+}
+
+llvm::Expected<llvm::orc::ThreadSafeModule> JITEngine::BuildBatchLoop(const std::string& name,
+                                                                      const std::string& loopName,
+                                                                      const JITSignature& signature,
+                                                                      JITBatchKind kind) {
+    auto context = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> module;
+    llvm::Function* callee = nullptr;
+
+    // With a saved copy of the callee, the loop gets a private definition
+    // that the optimizer inlines. Otherwise it calls the compiled function.
+    auto saved = batchCallees_.find(name);
+    if (saved != batchCallees_.end()) {
+        auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(*saved->second, name), *context);
+        if (!parsed) {
+            return parsed.takeError();
+        }
+        module = std::move(*parsed);
+        for (llvm::Function& function : *module) {
+            if (function.getName() != name && !function.isDeclaration()) {
+                function.deleteBody();
+            }
+        }
+        callee = module->getFunction(name);
+        callee->setLinkage(llvm::GlobalValue::InternalLinkage);
+        callee->addFnAttr(llvm::Attribute::AlwaysInline);
+        callee->removeFnAttr(llvm::Attribute::NoInline);
+        callee->removeFnAttr(llvm::Attribute::OptimizeNone);
+        module->setModuleIdentifier(loopName);
+    } else {
+        module = std::make_unique<llvm::Module>(loopName, *context);
+    }
+    module->setDataLayout(jit_->getDataLayout());
+    module->setTargetTriple(jit_->getTargetTriple().str());
+
+    std::vector<llvm::Type*> paramTypes;
+    for (JITValueKind paramKind : signature.paramKinds) {
+        paramTypes.push_back(TypeFromKind(*context, paramKind));
+    }
+    llvm::Type* returnType = TypeFromKind(*context, signature.returnKind);
+    if (!callee) {
+        callee = llvm::Function::Create(llvm::FunctionType::get(returnType, paramTypes, false),
+                                        llvm::Function::ExternalLinkage, name, module.get());
+    }
+
+    llvm::Type* bytePtrType = llvm::Type::getInt8PtrTy(*context);
+    llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
+    llvm::FunctionType* loopType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(*context),
+        {bytePtrType->getPointerTo(), int64Type, int64Type->getPointerTo()}, false);
+    llvm::Function* loop = llvm::Function::Create(loopType, llvm::Function::ExternalLinkage, loopName, module.get());
+    llvm::Value* columns = loop->getArg(0);
+    llvm::Value* count = loop->getArg(1);
+    llvm::Value* accumulatorSlot = loop->getArg(2);
+
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", loop);
+    llvm::BasicBlock* body = llvm::BasicBlock::Create(*context, "body", loop);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(*context, "exit", loop);
+    llvm::IRBuilder<> builder(entry);
+
+    // Map loops read every parameter from a column, reduce loops all but the
+    // accumulator
+    size_t firstColumnParam = kind == JITBatchKind::Reduce ? 1 : 0;
+    std::vector<llvm::Value*> columnPtrs;
+    std::vector<llvm::Type*> columnTypes;
+    for (size_t i = firstColumnParam; i <= paramTypes.size(); i++) {
+        if (i == paramTypes.size() && kind == JITBatchKind::Reduce) {
+            break;
+        }
+        llvm::Type* elementType = i < paramTypes.size() ? paramTypes[i] : returnType;
+        llvm::Value* columnSlot = builder.CreateConstInBoundsGEP1_64(bytePtrType, columns, columnPtrs.size());
+        llvm::Value* column = builder.CreateLoad(bytePtrType, columnSlot);
+        columnPtrs.push_back(builder.CreateBitCast(column, elementType->getPointerTo()));
+        columnTypes.push_back(elementType);
+    }
+
+    llvm::Value* initial = nullptr;
+    if (kind == JITBatchKind::Reduce) {
+        initial = LoadSlotValue(builder, builder.CreateLoad(int64Type, accumulatorSlot),
+                                signature.returnKind, returnType);
+    }
+    builder.CreateCondBr(builder.CreateICmpSGT(count, builder.getInt64(0)), body, exit);
+
+    builder.SetInsertPoint(body);
+    llvm::PHINode* index = builder.CreatePHI(int64Type, 2, "row");
+    index->addIncoming(builder.getInt64(0), entry);
+    llvm::PHINode* accumulator = nullptr;
+    std::vector<llvm::Value*> args;
+    if (kind == JITBatchKind::Reduce) {
+        accumulator = builder.CreatePHI(returnType, 2, "acc");
+        accumulator->addIncoming(initial, entry);
+        args.push_back(accumulator);
+    }
+    for (size_t i = 0; i + firstColumnParam < paramTypes.size(); i++) {
+        llvm::Value* element = builder.CreateInBoundsGEP(columnTypes[i], columnPtrs[i], index);
+        args.push_back(builder.CreateLoad(columnTypes[i], element));
+    }
+    llvm::Value* result = builder.CreateCall(callee, args);
+    if (kind == JITBatchKind::Map) {
+        builder.CreateStore(result, builder.CreateInBoundsGEP(returnType, columnPtrs.back(), index));
+    } else {
+        accumulator->addIncoming(result, body);
+    }
+    llvm::Value* next = builder.CreateAdd(index, builder.getInt64(1), "", true, true);
+    index->addIncoming(next, body);
+    builder.CreateCondBr(builder.CreateICmpSLT(next, count), body, exit);
+
+    builder.SetInsertPoint(exit);
+    if (kind == JITBatchKind::Reduce) {
+        llvm::PHINode* final = builder.CreatePHI(returnType, 2);
+        final->addIncoming(initial, entry);
+        final->addIncoming(result, body);
+        builder.CreateStore(StoreSlotValue(builder, final, signature.returnKind), accumulatorSlot);
+    }
+    builder.CreateRetVoid();
+
+    // Loops are worth optimizing even in engines that start at O0
+    auto targetMachine = targetMachineBuilder_.createTargetMachine();
+    if (!targetMachine) {
+        return targetMachine.takeError();
+    }
+    OptimizeModule(*module, OptimizationOptions(), targetMachine->get());
+    module->addModuleFlag(llvm::Module::Warning, codeGenLevelFlag, 2);
+
+    return llvm::orc::ThreadSafeModule(std::move(module), std::move(context));
+}
+
+llvm::Expected<JITBatchLoop> JITEngine::GetBatchLoop(const std::string& name, const JITSignature& signature,
+                                                     JITBatchKind kind) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string key = std::string(kind == JITBatchKind::Map ? "map:" : "reduce:") + name + ":" +
+        signature.Mangle();
+    auto it = batchLoops_.find(key);
+    if (it != batchLoops_.end()) {
+        return it->second;
+    }
+
+    // The loop is removed together with the module defining its callee
+    auto owner = definingModules_.find(name);
+    std::shared_ptr<JITModuleState> module = owner != definingModules_.end() ? owner->second.lock() : nullptr;
+    llvm::orc::ResourceTrackerSP tracker =
+        module ? module->tracker_ : jit_->getMainJITDylib().getDefaultResourceTracker();
+
+    std::string loopName = "__llvm_nodejs_batch." + std::to_string(wrappersBuilt_++);
+    auto loopModule = BuildBatchLoop(name, loopName, signature, kind);
+    if (!loopModule) {
+        return loopModule.takeError();
+    }
+    if (llvm::Error err = jit_->addIRModule(tracker, std::move(*loopModule))) {
+        return err;
+    }
+    auto symbol = jit_->lookup(loopName);
+    if (!symbol) {
+        return symbol.takeError();
+    }
+
+    JITBatchLoop loop = reinterpret_cast<JITBatchLoop>(static_cast<uintptr_t>(symbol->getAddress()));
+    batchLoops_[key] = loop;
+    if (module) {
+        module->wrapperKeys_.push_back(key);
+    }
+    return loop;
+}
+
+llvm::Error JITEngine::DefineSymbol(const std::string& name, llvm::JITTargetAddress address) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jit_->getMainJITDylib().define(llvm::orc::absoluteSymbols(
+        {{jit_->mangleAndIntern(name), llvm::JITEvaluatedSymbol(address, llvm::JITSymbolFlags::Exported)}}));
+}
+
+llvm::Error JITEngine::AddLibrarySymbols(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!hostLibraries_.insert(path).second) {
+        return llvm::Error::success();
+    }
+
+    // Only consulted for names that no module defines; lazy dylibs reach
+    // the generator through their link order
+    char prefix = jit_->getDataLayout().getGlobalPrefix();
+    auto generator = path.empty()
+        ? llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(prefix)
+        : llvm::orc::DynamicLibrarySearchGenerator::Load(path.c_str(), prefix);
+    if (!generator) {
+        hostLibraries_.erase(path);
+        return generator.takeError();
+    }
+    jit_->getMainJITDylib().addGenerator(std::move(*generator));
+    return llvm::Error::success();
+}
+
+llvm::Error JITEngine::DefineHostCallback(const std::string& name, const JITSignature& signature,
+                                          JITHostCallbackFn function, std::shared_ptr<void> context) {
+    auto llvmContext = std::make_unique<llvm::LLVMContext>();
+    auto module = std::make_unique<llvm::Module>("__llvm_nodejs_host." + name, *llvmContext);
+    module->setDataLayout(jit_->getDataLayout());
+    module->setTargetTriple(jit_->getTargetTriple().str());
+
+    std::vector<llvm::Type*> paramTypes;
+    for (JITValueKind kind : signature.paramKinds) {
+        paramTypes.push_back(TypeFromKind(*llvmContext, kind));
+    }
+    llvm::Type* returnType = TypeFromKind(*llvmContext, signature.returnKind);
+    llvm::Function* shim = llvm::Function::Create(llvm::FunctionType::get(returnType, paramTypes, false),
+                                                  llvm::Function::ExternalLinkage, name, module.get());
+
+    // The shim is the reverse of a call wrapper: it packs its arguments into
+    // slots and calls `function` at its absolute address
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(*llvmContext, "entry", shim));
+    llvm::Type* int64Type = builder.getInt64Ty();
+    llvm::Value* argSlots = builder.CreateAlloca(int64Type, builder.getInt64(std::max<size_t>(paramTypes.size(), 1)));
+    llvm::Value* retSlot = builder.CreateAlloca(int64Type);
+    for (unsigned i = 0; i < paramTypes.size(); i++) {
+        builder.CreateStore(StoreSlotValue(builder, shim->getArg(i), signature.paramKinds[i]),
+                            builder.CreateConstInBoundsGEP1_64(int64Type, argSlots, i));
+    }
+
+    llvm::Type* bytePtrType = builder.getInt8PtrTy();
+    llvm::FunctionType* calleeType = llvm::FunctionType::get(
+        builder.getVoidTy(), {bytePtrType, int64Type->getPointerTo(), int64Type->getPointerTo()}, false);
+    llvm::Value* callee = builder.CreateIntToPtr(
+        builder.getInt64(reinterpret_cast<uintptr_t>(function)), calleeType->getPointerTo());
+    llvm::Value* contextPtr = builder.CreateIntToPtr(
+        builder.getInt64(reinterpret_cast<uintptr_t>(context.get())), bytePtrType);
+    builder.CreateCall(calleeType, callee, {contextPtr, argSlots, retSlot});
+    if (signature.returnKind == JITValueKind::Void) {
+        builder.CreateRetVoid();
+    } else {
+        builder.CreateRet(LoadSlotValue(builder, builder.CreateLoad(int64Type, retSlot),
+                                        signature.returnKind, returnType));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (llvm::Error err = jit_->addIRModule(
+            llvm::orc::ThreadSafeModule(std::move(module), std::move(llvmContext)))) {
+        return err;
+    }
+    hostCallbackContexts_.push_back(std::move(context));
+    return llvm::Error::success();
+}
+
+//
+// JITFunction implementation
+//
+// BigInts that do not fit the parameter throw a RangeError instead of being
+// truncated; ToSlot then returns false with the exception pending
+static void ThrowBigIntRange(napi_env env) {
+    napi_throw_range_error(env, nullptr, "BigInt argument does not fit in 64 bits");
+}
+
+static bool ToSlot(const Napi::Value& value, JITValueKind kind, JITSlot& slot) {
+    switch (kind) {
+    case JITValueKind::Int1:
+        if (value.IsBoolean()) {
+            slot.i = value.As<Napi::Boolean>().Value() ? 1 : 0;
+            return true;
+        }
+        if (value.IsNumber()) {
+            slot.i = value.As<Napi::Number>().DoubleValue() != 0 ? 1 : 0;
+            return true;
+        }
+        return false;
+    case JITValueKind::Int8:
+    case JITValueKind::Int16:
+    case JITValueKind::Int32:
+        if (!value.IsNumber()) {
+            return false;
+        }
+        slot.i = value.As<Napi::Number>().Int64Value();
+        return true;
+    case JITValueKind::Int64:
+        if (value.IsBigInt()) {
+            bool lossless;
+            slot.i = value.As<Napi::BigInt>().Int64Value(&lossless);
+            if (!lossless) {
+                ThrowBigIntRange(value.Env());
+            }
+            return lossless;
+        }
+        if (value.IsNumber()) {
+            slot.i = value.As<Napi::Number>().Int64Value();
+            return true;
+        }
+        return false;
+    case JITValueKind::Float:
+    case JITValueKind::Double:
+        if (!value.IsNumber()) {
+            return false;
+        }
+        slot.d = value.As<Napi::Number>().DoubleValue();
+        return true;
+    case JITValueKind::Pointer:
+        // Raw addresses are passed as BigInt, arrays go through ArrayToSlot
+        if (value.IsNull() || value.IsUndefined()) {
+            slot.p = nullptr;
+            return true;
+        }
+        if (value.IsBigInt()) {
+            bool lossless;
+            slot.p = reinterpret_cast<void*>(
+                static_cast<uintptr_t>(value.As<Napi::BigInt>().Uint64Value(&lossless)));
+            if (!lossless) {
+                ThrowBigIntRange(value.Env());
+            }
+            return lossless;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+// TypedArray types whose elements match the pointee of a typed pointer
+static uint32_t ArrayTypesForPointee(JITValueKind pointeeKind) {
+    switch (pointeeKind) {
+    case JITValueKind::Int8:
+        return (1u << napi_int8_array) | (1u << napi_uint8_array) | (1u << napi_uint8_clamped_array);
+    case JITValueKind::Int16:
+        return (1u << napi_int16_array) | (1u << napi_uint16_array);
+    case JITValueKind::Int32:
+        return (1u << napi_int32_array) | (1u << napi_uint32_array);
+    case JITValueKind::Int64:
+    case JITValueKind::Pointer:
+        return (1u << napi_bigint64_array) | (1u << napi_biguint64_array);
+    case JITValueKind::Float:
+        return 1u << napi_float32_array;
+    case JITValueKind::Double:
+        return 1u << napi_float64_array;
+    default:
+        // Unknown pointee: any array is passed as raw bytes
+        return ~0u;
+    }
+}
+
+// Hands the backing store of a TypedArray, Buffer or ArrayBuffer to native
+// code without copying. Returns false if the value is not an acceptable
+// array, otherwise stores the element count in `length`.
+static bool ArrayToSlot(napi_env env, napi_value value, uint32_t arrayTypes,
+                       JITSlot& slot, int64_t& length) {
+    bool isTypedArray = false;
+    napi_is_typedarray(env, value, &isTypedArray);
+    if (isTypedArray) {
+        napi_typedarray_type type;
+        size_t elementLength;
+        void* data;
+        if (napi_get_typedarray_info(env, value, &type, &elementLength, &data, nullptr, nullptr) != napi_ok ||
+            !(arrayTypes & (1u << type))) {
+            return false;
+        }
+        slot.p = data;
+        length = static_cast<int64_t>(elementLength);
+        return true;
+    }
+
+    bool isArrayBuffer = false;
+    napi_is_arraybuffer(env, value, &isArrayBuffer);
+    if (isArrayBuffer && (arrayTypes & (1u << napi_uint8_array))) {
+        void* data;
+        size_t byteLength;
+        if (napi_get_arraybuffer_info(env, value, &data, &byteLength) != napi_ok) {
+            return false;
+        }
+        slot.p = data;
+        length = static_cast<int64_t>(byteLength);
+        return true;
+    }
+
+    return false;
+}
+
+static Napi::Value FromSlot(Napi::Env env, JITValueKind kind, const JITSlot& slot) {
+    switch (kind) {
+    case JITValueKind::Int1:
+        return Napi::Boolean::New(env, slot.i != 0);
+    case JITValueKind::Int8:
+    case JITValueKind::Int16:
+    case JITValueKind::Int32:
+        return Napi::Number::New(env, static_cast<double>(slot.i));
+    case JITValueKind::Int64:
+        return Napi::BigInt::New(env, slot.i);
+    case JITValueKind::Float:
+    case JITValueKind::Double:
+        return Napi::Number::New(env, slot.d);
+    case JITValueKind::Pointer:
+        return Napi::BigInt::New(env, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(slot.p)));
+    default:
+        return env.Undefined();
+    }
+}
+
+//
+// Specialized trampolines
+//
+// Converts one JS argument into a native parameter of type T
+template <typename T>
+struct JITArgConverter;
+
+template <>
+struct JITArgConverter<int32_t> {
+    static bool Convert(napi_env env, const napi_value* argv, const JITParamBinding& binding,
+                        int64_t* lengths, size_t, int32_t& out) {
+        if (binding.lengthOf >= 0) {
+            out = static_cast<int32_t>(lengths[binding.lengthOf]);
+            return true;
+        }
+        return napi_get_value_int32(env, argv[binding.jsIndex], &out) == napi_ok;
+    }
+};
+
+template <>
+struct JITArgConverter<int64_t> {
+    static bool Convert(napi_env env, const napi_value* argv, const JITParamBinding& binding,
+                        int64_t* lengths, size_t, int64_t& out) {
+        if (binding.lengthOf >= 0) {
+            out = lengths[binding.lengthOf];
+            return true;
+        }
+        // Numbers and BigInts are both accepted, as on the generic path
+        if (napi_get_value_int64(env, argv[binding.jsIndex], &out) == napi_ok) {
+            return true;
+        }
+        bool lossless;
+        if (napi_get_value_bigint_int64(env, argv[binding.jsIndex], &out, &lossless) != napi_ok) {
+            return false;
+        }
+        if (!lossless) {
+            ThrowBigIntRange(env);
+        }
+        return lossless;
+    }
+};
+
+template <>
+struct JITArgConverter<double> {
+    static bool Convert(napi_env env, const napi_value* argv, const JITParamBinding& binding,
+                        int64_t*, size_t, double& out) {
+        return napi_get_value_double(env, argv[binding.jsIndex], &out) == napi_ok;
+    }
+};
+
+template <>
+struct JITArgConverter<void*> {
+    static bool Convert(napi_env env, const napi_value* argv, const JITParamBinding& binding,
+                        int64_t* lengths, size_t index, void*& out) {
+        napi_value value = argv[binding.jsIndex];
+        napi_valuetype type;
+        if (napi_typeof(env, value, &type) != napi_ok) {
+            return false;
+        }
+
+        JITSlot slot;
+        if (type == napi_object) {
+            if (!ArrayToSlot(env, value, binding.arrayTypes, slot, lengths[index])) {
+                return false;
+            }
+        } else if (type == napi_null || type == napi_undefined) {
+            slot.p = nullptr;
+        } else if (type == napi_bigint) {
+            uint64_t address;
+            bool lossless;
+            napi_get_value_bigint_uint64(env, value, &address, &lossless);
+            if (!lossless) {
+                ThrowBigIntRange(env);
+                return false;
+            }
+            slot.p = reinterpret_cast<void*>(static_cast<uintptr_t>(address));
+        } else {
+            return false;
+        }
+        out = slot.p;
+        return true;
+    }
+};
+
+// Turns a native return value into a JS value
+static napi_value JITReturnValue(napi_env env, int32_t value) {
+    napi_value result;
+    napi_create_int32(env, value, &result);
+    return result;
+}
+
+static napi_value JITReturnValue(napi_env env, int64_t value) {
+    napi_value result;
+    napi_create_bigint_int64(env, value, &result);
+    return result;
+}
+
+static napi_value JITReturnValue(napi_env env, double value) {
+    napi_value result;
+    napi_create_double(env, value, &result);
+    return result;
+}
+
+static napi_value JITReturnValue(napi_env env, void* value) {
+    napi_value result;
+    napi_create_bigint_uint64(env, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)), &result);
+    return result;
+}
+
+template <typename Ret>
+struct JITInvoker {
+    template <typename... Params>
+    static napi_value Invoke(napi_env env, void* address, Params... args) {
+        return JITReturnValue(env, reinterpret_cast<Ret (*)(Params...)>(address)(args...));
+    }
+};
+
+template <>
+struct JITInvoker<void> {
+    template <typename... Params>
+    static napi_value Invoke(napi_env env, void* address, Params... args) {
+        reinterpret_cast<void (*)(Params...)>(address)(args...);
+        napi_value result;
+        napi_get_undefined(env, &result);
+        return result;
+    }
+};
+
+// Entry point of a JS function bound to a native function of type
+// Ret(Params...). The argument conversions are fixed at compile time.
+template <typename Ret, typename... Params>
+struct JITTrampoline {
+    static constexpr size_t arity = sizeof...(Params);
+
+    static napi_value Call(napi_env env, napi_callback_info info) {
+        return Run(env, info, std::index_sequence_for<Params...>());
+    }
+
+    template <size_t... I>
+    static napi_value Run(napi_env env, napi_callback_info info, std::index_sequence<I...>) {
+        size_t argc = arity;
+        napi_value argv[arity + 1];
+        void* data;
+        napi_get_cb_info(env, info, &argc, argv, nullptr, &data);
+        JITFunction* function = static_cast<JITFunction*>(data);
+
+        if (function->module_ && !function->module_->IsLoaded()) {
+            napi_throw_error(env, nullptr, "Function belongs to an unloaded module");
+            return nullptr;
+        }
+        if (argc != function->jsArgCount_) {
+            std::string message = "Expected " + std::to_string(function->jsArgCount_) + " arguments";
+            napi_throw_type_error(env, nullptr, message.c_str());
+            return nullptr;
+        }
+
+        // Parameters convert left to right, like on the generic path, so that
+        // length parameters see the arrays before them
+        std::tuple<Params...> args;
+        int64_t lengths[arity + 1] = {};
+        (void)lengths;
+        size_t failed = arity;
+        (void)std::initializer_list<int>{
+            (failed == arity &&
+                     !JITArgConverter<Params>::Convert(env, argv, function->bindings_[I], lengths, I,
+                                                       std::get<I>(args))
+                 ? (failed = I, 0)
+                 : 0)...};
+        if (failed != arity) {
+            bool pending = false;
+            napi_is_exception_pending(env, &pending);
+            if (!pending) {
+                std::string message =
+                    "Invalid argument at index " + std::to_string(function->bindings_[failed].jsIndex);
+                napi_throw_type_error(env, nullptr, message.c_str());
+            }
+            return nullptr;
+        }
+
+        return JITInvoker<Ret>::Invoke(env, function->address_, std::get<I>(args)...);
+    }
+};
+
+static const size_t maxTrampolineArity = 3;
+
+// Walks the parameter kinds, appending one native type per step, and
+// returns the trampoline for the complete list
+template <bool CanGrow, typename Ret, typename... Params>
+struct JITTrampolineTable;
+
+template <typename Ret, typename... Params>
+struct JITTrampolineTable<false, Ret, Params...> {
+    static napi_callback Find(const JITValueKind*, size_t count) {
+        return count == 0 ? &JITTrampoline<Ret, Params...>::Call : nullptr;
+    }
+};
+
+template <typename Ret, typename... Params>
+struct JITTrampolineTable<true, Ret, Params...> {
+    template <typename Next>
+    using Grow = JITTrampolineTable<(sizeof...(Params) + 1 < maxTrampolineArity), Ret, Params..., Next>;
+
+    static napi_callback Find(const JITValueKind* kinds, size_t count) {
+        if (count == 0) {
+            return &JITTrampoline<Ret, Params...>::Call;
+        }
+        switch (kinds[0]) {
+        case JITValueKind::Int32: return Grow<int32_t>::Find(kinds + 1, count - 1);
+        case JITValueKind::Int64: return Grow<int64_t>::Find(kinds + 1, count - 1);
+        case JITValueKind::Double: return Grow<double>::Find(kinds + 1, count - 1);
+        case JITValueKind::Pointer: return Grow<void*>::Find(kinds + 1, count - 1);
+        default: return nullptr;
+        }
+    }
+};
+
+napi_callback JITFunction::FindTrampoline(const JITSignature& signature) {
+    const JITValueKind* kinds = signature.paramKinds.data();
+    size_t count = signature.paramKinds.size();
+    switch (signature.returnKind) {
+    case JITValueKind::Void: return JITTrampolineTable<true, void>::Find(kinds, count);
+    case JITValueKind::Int32: return JITTrampolineTable<true, int32_t>::Find(kinds, count);
+    case JITValueKind::Int64: return JITTrampolineTable<true, int64_t>::Find(kinds, count);
+    case JITValueKind::Double: return JITTrampolineTable<true, double>::Find(kinds, count);
+    case JITValueKind::Pointer: return JITTrampolineTable<true, void*>::Find(kinds, count);
+    default: return nullptr;
+    }
+}
+
+Napi::Function JITFunction::Create(Napi::Env env, std::shared_ptr<JITEngine> engine,
+                                   std::shared_ptr<JITModuleState> module,
+                                   const std::string& name, const JITSignature& signature,
+                                   JITCallWrapper wrapper, napi_callback trampoline,
+                                   llvm::JITTargetAddress address, bool lengthArgs) {
+    JITFunction* function = new JITFunction();
+    function->engine_ = std::move(engine);
+    function->module_ = std::move(module);
+    function->signature_ = signature;
+    function->wrapper_ = wrapper;
+    function->address_ = reinterpret_cast<void*>(static_cast<uintptr_t>(address));
+    function->jsArgCount_ = 0;
+
+    // Work out the argument handling once so that calls only need to follow
+    // the bindings
+    for (size_t i = 0; i < signature.paramKinds.size(); i++) {
+        JITParamBinding binding;
+        binding.kind = signature.paramKinds[i];
+        binding.arrayTypes = 0;
+        binding.lengthOf = -1;
+        binding.jsIndex = static_cast<uint32_t>(function->jsArgCount_);
+
+        if (binding.kind == JITValueKind::Pointer) {
+            binding.arrayTypes = ArrayTypesForPointee(signature.pointeeKinds[i]);
+        } else if (lengthArgs && i > 0 && signature.paramKinds[i - 1] == JITValueKind::Pointer &&
+                   (binding.kind == JITValueKind::Int32 || binding.kind == JITValueKind::Int64)) {
+            binding.lengthOf = static_cast<int>(i - 1);
+        }
+
+        if (binding.lengthOf < 0) {
+            function->jsArgCount_++;
+        }
+        function->bindings_.push_back(binding);
+    }
+
+    Napi::Function func;
+    if (trampoline) {
+        napi_value value;
+        napi_create_function(env, name.c_str(), name.size(), trampoline, function, &value);
+        func = Napi::Function(env, value);
+    } else {
+        func = Napi::Function::New(env, &JITFunction::Call, name, function);
+    }
+    func.AddFinalizer([](Napi::Env, JITFunction* function) { delete function; }, function);
+
+    Napi::Value map = JITBatchFunction::Create(env, function->engine_, function->module_, name, signature,
+                                               JITBatchKind::Map);
+    if (!map.IsNull()) {
+        func.Set("map", map);
+    }
+    Napi::Value reduce = JITBatchFunction::Create(env, function->engine_, function->module_, name, signature,
+                                                  JITBatchKind::Reduce);
+    if (!reduce.IsNull()) {
+        func.Set("reduce", reduce);
+    }
+    return func;
+}
+
+Napi::Value JITFunction::Call(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    JITFunction* function = static_cast<JITFunction*>(info.Data());
+    const std::vector<JITParamBinding>& bindings = function->bindings_;
+
+    if (function->module_ && !function->module_->IsLoaded()) {
+        Napi::Error::New(env, "Function belongs to an unloaded module").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (info.Length() != function->jsArgCount_) {
+        Napi::TypeError::New(env, "Expected " + std::to_string(function->jsArgCount_) + " arguments")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    llvm::SmallVector<JITSlot, 8> args(bindings.size());
+    llvm::SmallVector<int64_t, 8> lengths(bindings.size(), 0);
+    size_t jsIndex = 0;
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const JITParamBinding& binding = bindings[i];
+        if (binding.lengthOf >= 0) {
+            args[i].i = lengths[binding.lengthOf];
+            continue;
+        }
+
+        Napi::Value value = info[jsIndex];
+        bool converted = binding.kind == JITValueKind::Pointer && value.IsObject()
+            ? ArrayToSlot(env, value, binding.arrayTypes, args[i], lengths[i])
+            : ToSlot(value, binding.kind, args[i]);
+        if (!converted) {
+            if (!env.IsExceptionPending()) {
+                Napi::TypeError::New(env, "Invalid argument at index " + std::to_string(jsIndex))
+                    .ThrowAsJavaScriptException();
+            }
+            return env.Undefined();
+        }
+        jsIndex++;
+    }
+
+    JITSlot ret;
+    ret.i = 0;
+    function->wrapper_(args.data(), &ret);
+
+    return FromSlot(env, function->signature_.returnKind, ret);
+}
+
+//
+// JITHostCallback implementation
+//
+std::shared_ptr<JITHostCallback> JITHostCallback::Create(Napi::Env env, Napi::Function callback,
+                                                         const JITSignature& signature) {
+    std::shared_ptr<JITHostCallback> host(new JITHostCallback());
+    host->env_ = env;
+    host->thread_ = std::this_thread::get_id();
+    host->target_ = std::make_shared<Target>();
+    host->target_->callback = Napi::Persistent(callback);
+    host->signature_ = signature;
+
+    // The thread-safe function must not keep the event loop alive on its
+    // own; it goes away when the engine releases it
+    host->tsfn_ = Napi::ThreadSafeFunction::New(
+        env, callback, "llvm_nodejs.hostCallback", 0, 1,
+        [](Napi::Env, std::shared_ptr<Target>* target) {
+            {
+                std::lock_guard<std::mutex> lock((*target)->mutex);
+                (*target)->finalized = true;
+                (*target)->callback.Reset();
+            }
+            delete target;
+        },
+        new std::shared_ptr<Target>(host->target_));
+    host->tsfn_.Unref(env);
+    return host;
+}
+
+JITHostCallback::~JITHostCallback() {
+    std::lock_guard<std::mutex> lock(target_->mutex);
+    if (!target_->finalized) {
+        tsfn_.Release();
+    }
+}
+
+// Runs on the JS thread. Exceptions stay pending and surface when control
+// returns to JS.
+void JITHostCallback::Run(Napi::Env env, Napi::Function callback, const JITSlot* args, JITSlot* ret) {
+    Napi::HandleScope scope(env);
+    std::vector<napi_value> argv;
+    for (size_t i = 0; i < signature_.paramKinds.size(); i++) {
+        argv.push_back(FromSlot(env, signature_.paramKinds[i], args[i]));
+    }
+
+    ret->i = 0;
+    Napi::Value result = callback.Call(argv);
+    if (env.IsExceptionPending() || signature_.returnKind == JITValueKind::Void) {
+        return;
+    }
+    if (!ToSlot(result, signature_.returnKind, *ret)) {
+        ret->i = 0;
+        if (!env.IsExceptionPending()) {
+            Napi::TypeError::New(env, "Host callback returned a value of the wrong type")
+                .ThrowAsJavaScriptException();
+        }
+    }
+}
+
+void JITHostCallback::Invoke(void* context, const JITSlot* args, JITSlot* ret) {
+    JITHostCallback* host = static_cast<JITHostCallback*>(context);
+    if (std::this_thread::get_id() == host->thread_) {
+        // A finalized target means the environment is gone and the thread
+        // id belongs to a new thread. Otherwise the finalizer can only run
+        // on this thread, so the callback stays valid once checked.
+        bool finalized;
+        {
+            std::lock_guard<std::mutex> lock(host->target_->mutex);
+            finalized = host->target_->finalized;
+        }
+        if (finalized) {
+            ret->i = 0;
+            return;
+        }
+        host->Run(Napi::Env(host->env_), host->target_->callback.Value(), args, ret);
+        return;
+    }
+
+    // Other threads hand the call to the JS thread and wait for it
+    struct PendingCall {
+        const JITSlot* args;
+        JITSlot* ret;
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished = false;
+    } call;
+    call.args = args;
+    call.ret = ret;
+    ret->i = 0;
+
+    napi_status status = host->tsfn_.BlockingCall(&call, [host](Napi::Env env, Napi::Function callback,
+                                                                PendingCall* call) {
+        host->Run(env, callback, call->args, call->ret);
+        std::lock_guard<std::mutex> lock(call->mutex);
+        call->finished = true;
+        call->done.notify_one();
+    });
+    if (status != napi_ok) {
+        // The registering thread has shut down
+        return;
+    }
+    std::unique_lock<std::mutex> lock(call.mutex);
+    call.done.wait(lock, [&call] { return call.finished; });
+}
+
+//
+// JITBatchFunction implementation
+//
+Napi::Value JITBatchFunction::Create(Napi::Env env, std::shared_ptr<JITEngine> engine,
+                                     std::shared_ptr<JITModuleState> module, const std::string& name,
+                                     const JITSignature& signature, JITBatchKind kind) {
+    if (!IsBatchSignature(signature, kind)) {
+        return env.Null();
+    }
+
+    JITBatchFunction* batch = new JITBatchFunction();
+    batch->engine_ = std::move(engine);
+    batch->module_ = std::move(module);
+    batch->name_ = name;
+    batch->signature_ = signature;
+    batch->kind_ = kind;
+    batch->loop_ = nullptr;
+
+    Napi::Function func = Napi::Function::New(env, &JITBatchFunction::Call,
+                                              kind == JITBatchKind::Map ? "map" : "reduce", batch);
+    func.AddFinalizer([](Napi::Env, JITBatchFunction* batch) { delete batch; }, batch);
+    return func;
+}
+
+// fn.map(inputs, output) fills `output` with fn applied to the rows of the
+// `inputs` columns and returns it. fn.reduce(inputs, initial) folds the
+// rows into the accumulator, which is passed as the first argument.
+Napi::Value JITBatchFunction::Call(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    JITBatchFunction* batch = static_cast<JITBatchFunction*>(info.Data());
+    const JITSignature& signature = batch->signature_;
+    bool isMap = batch->kind_ == JITBatchKind::Map;
+
+    if (batch->module_ && !batch->module_->IsLoaded()) {
+        Napi::Error::New(env, "Function belongs to an unloaded module").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    size_t inputCount = signature.paramKinds.size() - (isMap ? 0 : 1);
+    if (info.Length() < 2 || !info[0].IsArray() || info[0].As<Napi::Array>().Length() != inputCount) {
+        Napi::TypeError::New(env, "Array of " + std::to_string(inputCount) + " input columns expected")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Every column is checked against the element kind of its parameter and
+    // handed over without copying
+    Napi::Array inputs = info[0].As<Napi::Array>();
+    llvm::SmallVector<void*, 8> columns;
+    int64_t rows = -1;
+    for (uint32_t i = 0; i <= inputCount; i++) {
+        if (i == inputCount && !isMap) {
+            break;
+        }
+        Napi::Value column = i < inputCount ? inputs.Get(i) : info[1];
+        JITValueKind kind = i < inputCount ? signature.paramKinds[i + (isMap ? 0 : 1)] : signature.returnKind;
+        JITSlot slot;
+        int64_t length;
+        if (!column.IsObject() || !ArrayToSlot(env, column, ArrayTypesForPointee(kind), slot, length)) {
+            std::string what = i < inputCount ? "Input column " + std::to_string(i) : std::string("Output");
+            Napi::TypeError::New(env, what + " must be a TypedArray of " + KindName(kind) + " elements")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (rows >= 0 && length != rows) {
+            Napi::RangeError::New(env, "All columns must have the same length").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        rows = length;
+        columns.push_back(slot.p);
+    }
+
+    JITSlot accumulator;
+    accumulator.i = 0;
+    if (!isMap && !ToSlot(info[1], signature.returnKind, accumulator)) {
+        if (!env.IsExceptionPending()) {
+            Napi::TypeError::New(env, "Invalid initial value").ThrowAsJavaScriptException();
+        }
+        return env.Undefined();
+    }
+
+    if (!batch->loop_) {
+        auto loop = batch->engine_->GetBatchLoop(batch->name_, signature, batch->kind_);
+        if (!loop) {
+            Napi::Error::New(env, llvm::toString(loop.takeError())).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        batch->loop_ = *loop;
+    }
+
+    batch->loop_(columns.data(), rows, &accumulator);
+
+    if (isMap) {
+        return info[1];
+    }
+    return FromSlot(env, signature.returnKind, accumulator);
+}
+
+//
+// JITEngineWrapper implementation
+//
+JITEngineWrapper::JITEngineWrapper(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<JITEngineWrapper>(info) {
+    Napi::Env env = info.Env();
+
+    // An engine shared by another thread, handed over by fromShared()
+    if (info.Length() == 1 && info[0].IsExternal()) {
+        std::unique_ptr<std::shared_ptr<JITEngine>> engine(
+            info[0].As<Napi::External<std::shared_ptr<JITEngine>>>().Data());
+        engine_ = std::move(*engine);
+        return;
+    }
+
+    JITEngineOptions options;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object optionsObj = info[0].As<Napi::Object>();
+        options.lazy = optionsObj.Get("lazy").ToBoolean();
+        options.tiered = optionsObj.Get("tiered").ToBoolean();
+        options.dedupe = optionsObj.Get("dedupe").ToBoolean();
+        options.batchInlining = optionsObj.Get("batchInlining").ToBoolean();
+        options.redefinable = optionsObj.Get("redefinable").ToBoolean();
+        options.instrument = optionsObj.Get("instrument").ToBoolean();
+
+        Napi::Value cacheDir = optionsObj.Get("cacheDir");
+        if (cacheDir.IsString()) {
+            options.cacheDir = cacheDir.As<Napi::String>().Utf8Value();
+        }
+        Napi::Value cacheMaxBytes = optionsObj.Get("cacheMaxBytes");
+        if (cacheMaxBytes.IsNumber()) {
+            options.cacheMaxBytes = cacheMaxBytes.As<Napi::Number>().Int64Value();
+        }
+
+        Napi::Value compileThreads = optionsObj.Get("compileThreads");
+        if (compileThreads.IsNumber()) {
+            options.compileThreads = compileThreads.As<Napi::Number>().Uint32Value();
+        }
+
+        Napi::Value threshold = optionsObj.Get("tierUpThreshold");
+        if (threshold.IsNumber()) {
+            options.tierUpThreshold = threshold.As<Napi::Number>().Int64Value();
+        }
+        Napi::Value optLevel = optionsObj.Get("tierUpOptLevel");
+        if (optLevel.IsNumber()) {
+            options.tierUpOptLevel = optLevel.As<Napi::Number>().Uint32Value();
+        }
+        if (options.tierUpThreshold < 1 || options.tierUpOptLevel > 3) {
+            Napi::RangeError::New(env, "tierUpThreshold must be positive and tierUpOptLevel 0-3")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+    }
+
+    auto engine = JITEngine::Create(options);
+    if (!engine) {
+        Napi::Error::New(env, "Failed to create JIT: " + llvm::toString(engine.takeError()))
+            .ThrowAsJavaScriptException();
+        return;
+    }
+    engine_ = std::move(*engine);
+}
+
+Napi::Object JITEngineWrapper::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "JITEngine", {
+        InstanceMethod("addModule", &JITEngineWrapper::AddModule),
+        InstanceMethod("addModules", &JITEngineWrapper::AddModules),
+        InstanceMethod("getFunction", &JITEngineWrapper::GetFunction),
+        InstanceMethod("getStats", &JITEngineWrapper::GetStats),
+        InstanceMethod("getProfile", &JITEngineWrapper::GetProfile),
+        InstanceMethod("resetProfile", &JITEngineWrapper::ResetProfile),
+        InstanceMethod("getTierInfo", &JITEngineWrapper::GetTierInfo),
+        InstanceMethod("share", &JITEngineWrapper::Share),
+        InstanceMethod("shareFunction", &JITEngineWrapper::ShareFunction),
+        InstanceMethod("defineSymbol", &JITEngineWrapper::DefineSymbol),
+        InstanceMethod("loadLibrary", &JITEngineWrapper::AddLibrary),
+        InstanceMethod("defineCallback", &JITEngineWrapper::DefineCallback),
+        InstanceMethod("redefine", &JITEngineWrapper::Redefine),
+        StaticMethod("fromShared", &JITEngineWrapper::FromShared),
+        StaticMethod("importFunction", &JITEngineWrapper::ImportFunction)
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("JITEngine", func);
+    return exports;
+}
+
+// Returns the wrapper of a module that can be handed to a JIT engine, or
+// throws and returns null
+static ModuleWrapper* UnwrapModuleForJIT(Napi::Env env, const Napi::Value& value) {
+    if (!value.IsObject() || !ModuleWrapper::IsInstance(value.As<Napi::Object>())) {
+        Napi::TypeError::New(env, "Module argument expected").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    ModuleWrapper* moduleWrapper = Napi::ObjectWrap<ModuleWrapper>::Unwrap(value.As<Napi::Object>());
+    llvm::Module* module = moduleWrapper->GetModule();
+    if (!module) {
+        Napi::Error::New(env, "Module has already been handed over to a JIT engine")
+            .ThrowAsJavaScriptException();
+        return nullptr;
+    }
+    if (!CheckContextUnlocked(env, module->getContext())) {
+        return nullptr;
+    }
+
+    // Invalid IR would crash the code generator, so reject it while the
+    // module still belongs to the caller
+    std::string errorStr;
+    llvm::raw_string_ostream errorStream(errorStr);
+    if (llvm::verifyModule(*module, &errorStream)) {
+        errorStream.flush();
+        Napi::Error::New(env, "Module verification failed: " + errorStr)
+            .ThrowAsJavaScriptException();
+        return nullptr;
+    }
+    return moduleWrapper;
+}
+
+// With { unloadWhenUnreachable: true } the engine does not keep the code
+// alive itself; it is removed once the returned JITModule and every function
+// handle bound to it have been garbage collected
+static bool RetainModules(const Napi::CallbackInfo& info, size_t index) {
+    if (info.Length() > index && info[index].IsObject()) {
+        return !info[index].As<Napi::Object>().Get("unloadWhenUnreachable").ToBoolean();
+    }
+    return true;
+}
+
+Napi::Value JITEngineWrapper::AddModule(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    ModuleWrapper* moduleWrapper = UnwrapModuleForJIT(env, info.Length() > 0 ? info[0] : env.Undefined());
+    if (!moduleWrapper) {
+        return env.Undefined();
+    }
+
+    auto module = engine_->AddModule(moduleWrapper->TakeModule(), RetainModules(info, 1));
+    if (!module) {
+        Napi::Error::New(env, llvm::toString(module.takeError())).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return JITModuleWrapper::Create(env, engine_, std::move(*module));
+}
+
+Napi::Value JITEngineWrapper::AddModules(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Array of modules expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Check every module before taking any of them
+    Napi::Array array = info[0].As<Napi::Array>();
+    std::vector<ModuleWrapper*> moduleWrappers;
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        ModuleWrapper* moduleWrapper = UnwrapModuleForJIT(env, array.Get(i));
+        if (!moduleWrapper) {
+            return env.Undefined();
+        }
+        if (std::find(moduleWrappers.begin(), moduleWrappers.end(), moduleWrapper) != moduleWrappers.end()) {
+            Napi::Error::New(env, "Module passed more than once").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        moduleWrappers.push_back(moduleWrapper);
+    }
+
+    std::vector<llvm::orc::ThreadSafeModule> modules;
+    for (ModuleWrapper* moduleWrapper : moduleWrappers) {
+        modules.push_back(moduleWrapper->TakeModule());
+    }
+    auto added = engine_->AddModules(std::move(modules), RetainModules(info, 1));
+    if (!added) {
+        Napi::Error::New(env, llvm::toString(added.takeError())).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Array result = Napi::Array::New(env, added->size());
+    for (uint32_t i = 0; i < added->size(); i++) {
+        result.Set(i, JITModuleWrapper::Create(env, engine_, (*added)[i]));
+    }
+    return result;
+}
+
+Napi::Value JITEngineWrapper::GetFunction(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Function name expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+
+    // The second argument is either a FunctionType or an options object
+    // { type, lengthArgs, specialize }
+    Napi::Value typeValue = env.Undefined();
+    bool lengthArgs = false;
+    bool specialize = true;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object arg = info[1].As<Napi::Object>();
+        if (arg.InstanceOf(FunctionTypeWrapper::constructor.Value())) {
+            typeValue = arg;
+        } else {
+            typeValue = arg.Get("type");
+            lengthArgs = arg.Get("lengthArgs").ToBoolean();
+            Napi::Value specializeValue = arg.Get("specialize");
+            specialize = specializeValue.IsUndefined() || specializeValue.ToBoolean();
+        }
+    }
+
+    // An explicit function type is only needed for symbols whose IR the
+    // engine has not seen
+    JITSignature signature;
+    if (typeValue.IsObject()) {
+        Napi::Object typeObj = typeValue.As<Napi::Object>();
+        if (!typeObj.InstanceOf(FunctionTypeWrapper::constructor.Value())) {
+            Napi::TypeError::New(env, "FunctionType argument expected").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        llvm::FunctionType* type = Napi::ObjectWrap<FunctionTypeWrapper>::Unwrap(typeObj)->GetFunctionType();
+        if (!JITSignature::FromFunctionType(type, signature)) {
+            Napi::TypeError::New(env, "Unsupported function signature").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    } else if (!engine_->GetSignature(name, signature)) {
+        Napi::Error::New(env, "No callable definition found for function: " + name)
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Common signatures are called directly through a trampoline compiled
+    // for them; everything else goes through a generated slot wrapper
+    napi_callback trampoline = specialize ? JITFunction::FindTrampoline(signature) : nullptr;
+    if (trampoline) {
+        auto address = engine_->GetFunctionAddress(name);
+        if (!address) {
+            Napi::Error::New(env, llvm::toString(address.takeError())).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        return JITFunction::Create(env, engine_, engine_->GetDefiningModule(name), name, signature,
+                                   nullptr, trampoline, *address, lengthArgs);
+    }
+
+    auto wrapper = engine_->GetCallWrapper(name, signature);
+    if (!wrapper) {
+        Napi::Error::New(env, llvm::toString(wrapper.takeError())).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return JITFunction::Create(env, engine_, engine_->GetDefiningModule(name), name, signature,
+                               *wrapper, nullptr, 0, lengthArgs);
+}
+
+Napi::Value JITEngineWrapper::GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    JITEngineStats stats = engine_->GetStats();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("modulesAdded", Napi::Number::New(env, static_cast<double>(stats.modulesAdded)));
+    result.Set("functionsAdded", Napi::Number::New(env, static_cast<double>(stats.functionsAdded)));
+    result.Set("functionsMaterialized", Napi::Number::New(env, static_cast<double>(stats.functionsMaterialized)));
+    result.Set("tierUps", Napi::Number::New(env, static_cast<double>(stats.tierUps)));
+    result.Set("tierUpFailures", Napi::Number::New(env, static_cast<double>(stats.tierUpFailures)));
+    result.Set("cacheHits", Napi::Number::New(env, static_cast<double>(stats.cacheHits)));
+    result.Set("cacheMisses", Napi::Number::New(env, static_cast<double>(stats.cacheMisses)));
+    result.Set("cacheEvictions", Napi::Number::New(env, static_cast<double>(stats.cacheEvictions)));
+    result.Set("dedupeHits", Napi::Number::New(env, static_cast<double>(stats.dedupeHits)));
+    result.Set("dedupeMisses", Napi::Number::New(env, static_cast<double>(stats.dedupeMisses)));
+    uint64_t dedupeLookups = stats.dedupeHits + stats.dedupeMisses;
+    result.Set("dedupeHitRate", Napi::Number::New(
+        env, dedupeLookups ? static_cast<double>(stats.dedupeHits) / dedupeLookups : 0.0));
+    result.Set("dedupeBytesSaved", Napi::Number::New(env, static_cast<double>(stats.dedupeBytesSaved)));
+    result.Set("modulesUnloaded", Napi::Number::New(env, static_cast<double>(stats.modulesUnloaded)));
+    result.Set("liveCodeBytes", Napi::Number::New(env, static_cast<double>(stats.liveCodeBytes)));
+    result.Set("liveDataBytes", Napi::Number::New(env, static_cast<double>(stats.liveDataBytes)));
+    return result;
+}
+
+// getProfile() returns { [function]: { entryCount, branches: [[count per
+// successor], ...] } }, the shape module.applyProfile takes
+Napi::Value JITEngineWrapper::GetProfile(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    auto profile = engine_->GetProfile();
+    if (!profile) {
+        Napi::Error::New(env, "Failed to read profile: " + llvm::toString(profile.takeError()))
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    for (const auto& function : *profile) {
+        Napi::Object counts = Napi::Object::New(env);
+        counts.Set("entryCount", Napi::Number::New(env, static_cast<double>(function.second.entryCount)));
+        Napi::Array branches = Napi::Array::New(env, function.second.branches.size());
+        for (size_t i = 0; i < function.second.branches.size(); i++) {
+            const std::vector<uint64_t>& edges = function.second.branches[i];
+            Napi::Array edgeCounts = Napi::Array::New(env, edges.size());
+            for (size_t j = 0; j < edges.size(); j++) {
+                edgeCounts.Set(j, Napi::Number::New(env, static_cast<double>(edges[j])));
+            }
+            branches.Set(i, edgeCounts);
+        }
+        counts.Set("branches", branches);
+        result.Set(function.first, counts);
+    }
+    return result;
+}
+
+Napi::Value JITEngineWrapper::ResetProfile(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (llvm::Error err = engine_->ResetProfile()) {
+        Napi::Error::New(env, "Failed to reset profile: " + llvm::toString(std::move(err)))
+            .ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+Napi::Value JITEngineWrapper::GetTierInfo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Function name expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    JITTierInfo tierInfo;
+    if (!engine_->GetTierInfo(info[0].As<Napi::String>().Utf8Value(), tierInfo)) {
+        return env.Null();
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("tier", Napi::Number::New(env, tierInfo.tier));
+    result.Set("calls", Napi::Number::New(env, static_cast<double>(tierInfo.calls)));
+    return result;
+}
+
+// redefine(name, module) returns a Promise that resolves once every caller
+// of `name` has been switched over to the body defined by `module`
+Napi::Value JITEngineWrapper::Redefine(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected function name and module").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ModuleWrapper* moduleWrapper = UnwrapModuleForJIT(env, info[1]);
+    if (!moduleWrapper) {
+        return env.Undefined();
+    }
+
+    RedefineJob* job = new RedefineJob(env, info[1].As<Napi::Object>(), engine_,
+                                       info[0].As<Napi::String>().Utf8Value(), moduleWrapper->TakeModule());
+    Napi::Promise promise = job->GetPromise();
+    job->Queue();
+    return promise;
+}
+
+// The id is a plain number, so it can be posted to worker threads. Calls
+// from every thread go to the same compiled code.
+Napi::Value JITEngineWrapper::Share(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    auto id = engine_->Share();
+    if (!id) {
+        Napi::Error::New(env, llvm::toString(id.takeError())).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    return Napi::Number::New(env, static_cast<double>(*id));
+}
+
+// Transferable handle { engine, name } of a function, for importFunction()
+Napi::Value JITEngineWrapper::ShareFunction(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Function name expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    JITSignature signature;
+    if (!engine_->GetSignature(name, signature)) {
+        Napi::Error::New(env, "Function '" + name + "' is not defined by an added module")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto id = engine_->Share();
+    if (!id) {
+        Napi::Error::New(env, llvm::toString(id.takeError())).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object handle = Napi::Object::New(env);
+    handle.Set("engine", Napi::Number::New(env, static_cast<double>(*id)));
+    handle.Set("name", Napi::String::New(env, name));
+    return handle;
+}
+
+// defineSymbol(name, address) binds a name that JIT code can call or load
+// from to a native address, given as a BigInt or a Number
+Napi::Value JITEngineWrapper::DefineSymbol(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !(info[1].IsBigInt() || info[1].IsNumber())) {
+        Napi::TypeError::New(env, "Expected symbol name and address").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // JIT code jumps to whatever address it gets, so never wrap or truncate
+    uint64_t address;
+    bool lossless = true;
+    if (info[1].IsBigInt()) {
+        address = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    } else {
+        double value = info[1].As<Napi::Number>().DoubleValue();
+        lossless = value >= 0 && value <= 9007199254740991.0 && std::floor(value) == value;
+        address = static_cast<uint64_t>(value);
+    }
+    if (!lossless) {
+        Napi::RangeError::New(env, "Address must be a non-negative integer that fits in 64 bits")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (llvm::Error err = engine_->DefineSymbol(info[0].As<Napi::String>().Utf8Value(), address)) {
+        Napi::Error::New(env, "Failed to define symbol: " + llvm::toString(std::move(err)))
+            .ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// loadLibrary(path) lets JIT code call the exported functions of a shared
+// library by name; without a path, those of the process (libc, ...)
+Napi::Value JITEngineWrapper::AddLibrary(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::string path;
+    if (info.Length() > 0 && info[0].IsString()) {
+        path = info[0].As<Napi::String>().Utf8Value();
+    } else if (info.Length() > 0 && !info[0].IsUndefined()) {
+        Napi::TypeError::New(env, "Library path expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (llvm::Error err = engine_->AddLibrarySymbols(path)) {
+        Napi::Error::New(env, "Failed to load library: " + llvm::toString(std::move(err)))
+            .ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// defineCallback(name, functionType, callback) defines `name` as a native
+// function that calls back into JS, so modules can declare and call it
+Napi::Value JITEngineWrapper::DefineCallback(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsString() || !info[1].IsObject() ||
+        !info[1].As<Napi::Object>().InstanceOf(FunctionTypeWrapper::constructor.Value()) ||
+        !info[2].IsFunction()) {
+        Napi::TypeError::New(env, "Expected symbol name, function type and callback")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    FunctionTypeWrapper* typeWrapper = Napi::ObjectWrap<FunctionTypeWrapper>::Unwrap(info[1].As<Napi::Object>());
+    JITSignature signature;
+    if (!JITSignature::FromFunctionType(typeWrapper->GetFunctionType(), signature)) {
+        Napi::TypeError::New(env, "Unsupported callback signature").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::shared_ptr<JITHostCallback> host = JITHostCallback::Create(env, info[2].As<Napi::Function>(), signature);
+    if (llvm::Error err = engine_->DefineHostCallback(info[0].As<Napi::String>().Utf8Value(), signature,
+                                                      &JITHostCallback::Invoke, host)) {
+        Napi::Error::New(env, "Failed to define callback: " + llvm::toString(std::move(err)))
+            .ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// Wraps the engine shared under `id` for the calling thread, or throws and
+// returns undefined
+static Napi::Value AttachSharedEngine(Napi::Env env, Napi::FunctionReference& constructor,
+                                      const Napi::Value& id) {
+    if (!id.IsNumber()) {
+        Napi::TypeError::New(env, "Shared engine id expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::shared_ptr<JITEngine> engine = JITEngine::FromShared(id.As<Napi::Number>().Int64Value());
+    if (!engine) {
+        Napi::Error::New(env, "Shared JIT engine no longer exists").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::External<std::shared_ptr<JITEngine>> external = Napi::External<std::shared_ptr<JITEngine>>::New(
+        env, new std::shared_ptr<JITEngine>(std::move(engine)));
+    return constructor.New({ external });
+}
+
+// JITEngine.fromShared(id) attaches to an engine shared by another thread.
+// The sharing thread has to keep its engine alive until then.
+Napi::Value JITEngineWrapper::FromShared(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    return AttachSharedEngine(env, constructor, info.Length() > 0 ? info[0] : env.Undefined());
+}
+
+// JITEngine.importFunction(handle, options) returns a callable for a handle
+// from shareFunction(); options are those of getFunction()
+Napi::Value JITEngineWrapper::ImportFunction(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Function handle expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object handle = info[0].As<Napi::Object>();
+
+    Napi::Value engine = AttachSharedEngine(env, constructor, handle.Get("engine"));
+    if (!engine.IsObject()) {
+        return env.Undefined();
+    }
+    Napi::Object engineObj = engine.As<Napi::Object>();
+    return engineObj.Get("getFunction").As<Napi::Function>().Call(
+        engineObj, { handle.Get("name"), info.Length() > 1 ? info[1] : env.Undefined() });
+}
+
+//
+// JITModuleWrapper implementation
+//
+// Engine and module handed from Create() to the constructor
+struct JITModuleHandle {
+    std::shared_ptr<JITEngine> engine;
+    std::shared_ptr<JITModuleState> module;
+};
+
+JITModuleWrapper::JITModuleWrapper(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<JITModuleWrapper>(info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() == 1 && info[0].IsExternal()) {
+        std::unique_ptr<JITModuleHandle> handle(info[0].As<Napi::External<JITModuleHandle>>().Data());
+        engine_ = std::move(handle->engine);
+        module_ = std::move(handle->module);
+    } else {
+        Napi::TypeError::New(env, "JITModule constructor is not meant to be called directly")
+            .ThrowAsJavaScriptException();
+    }
+}
+
+Napi::Object JITModuleWrapper::Create(Napi::Env env, std::shared_ptr<JITEngine> engine,
+                                      std::shared_ptr<JITModuleState> module) {
+    Napi::External<JITModuleHandle> external = Napi::External<JITModuleHandle>::New(
+        env, new JITModuleHandle{std::move(engine), std::move(module)});
+    return constructor.New({ external });
+}
+
+Napi::Object JITModuleWrapper::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "JITModule", {
+        InstanceMethod("unload", &JITModuleWrapper::Unload),
+        InstanceMethod("isLoaded", &JITModuleWrapper::IsLoaded)
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("JITModule", func);
+    return exports;
+}
+
+Napi::Value JITModuleWrapper::Unload(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (llvm::Error err = engine_->Unload(module_)) {
+        Napi::Error::New(env, llvm::toString(std::move(err))).ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+Napi::Value JITModuleWrapper::IsLoaded(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), module_->IsLoaded());
+}
+
+}  // namespace llvm_nodejs
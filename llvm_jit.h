@@ -0,0 +1,570 @@
+#pragma once
+
+#include <napi.h>
+#include "llvm_cache.h"
+#include "llvm_profile.h"
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llvm_nodejs {
+
+// Scalar kinds that can cross the JS <-> native boundary
+enum class JITValueKind {
+    Void,
+    Int1,
+    Int8,
+    Int16,
+    Int32,
+    Int64,
+    Float,
+    Double,
+    Pointer
+};
+
+// Storage for one argument or return value. Integers are sign-extended to
+// 64 bits and floats are widened to double before they are stored.
+union JITSlot {
+    int64_t i;
+    double d;
+    void* p;
+};
+
+// Every compiled function is called through a generated wrapper with this
+// signature, so one native entry point can serve any supported IR signature.
+using JITCallWrapper = void (*)(const JITSlot* args, JITSlot* ret);
+
+// Loop generated around a scalar function that runs it over `count` rows of
+// columnar data. Map loops read one column per parameter and write the
+// result column after them. Reduce loops pass the accumulator, which starts
+// out and ends up in `accumulator`, as the first argument and read the
+// remaining parameters from the columns.
+enum class JITBatchKind {
+    Map,
+    Reduce
+};
+using JITBatchLoop = void (*)(void* const* columns, int64_t count, JITSlot* accumulator);
+
+// Native side of a host callback. The shim defined for the callback packs
+// its arguments into slots and calls this with the registered context.
+using JITHostCallbackFn = void (*)(void* context, const JITSlot* args, JITSlot* ret);
+
+struct JITSignature {
+    JITValueKind returnKind = JITValueKind::Void;
+    std::vector<JITValueKind> paramKinds;
+    // Element kind of each typed pointer parameter, Void when the parameter
+    // is not a pointer or the pointee is unknown (opaque pointers, structs)
+    std::vector<JITValueKind> pointeeKinds;
+
+    // Returns false if the function type uses unsupported types (structs,
+    // vectors, varargs, ...)
+    static bool FromFunctionType(llvm::FunctionType* type, JITSignature& signature);
+    std::string Mangle() const;
+};
+
+struct JITEngineOptions {
+    // Compile each function on its first call through a lazy reexport stub
+    // instead of compiling whole modules up front
+    bool lazy = false;
+
+    // Number of ORC compile threads. With 0 every module is compiled on the
+    // thread that looks it up. Modules only compile in parallel when they
+    // live in different contexts.
+    unsigned compileThreads = 0;
+
+    // Directory of a persistent object cache shared across processes, and
+    // its size cap in bytes (0 for none). Empty disables the cache.
+    std::string cacheDir;
+    uint64_t cacheMaxBytes = 0;
+
+    // Reuse the compiled code of structurally identical functions (equal
+    // up to the names of the function and its local values) instead of
+    // compiling them again. Not combined with tiering or redefinable.
+    bool dedupe = false;
+
+    // Call every function through an indirection stub, as tiered engines
+    // do, so that JITEngine.redefine can swap in a new body while callers
+    // keep running. fn.map loops then call instead of inlining.
+    bool redefinable = false;
+
+    // Keep the IR of small leaf functions with scalar signatures so that the
+    // loops of fn.map and fn.reduce can inline them instead of calling them
+    bool batchInlining = false;
+
+    // Start every function at O0 behind an indirection stub and recompile it
+    // at `tierUpOptLevel` on a background thread once it has been called
+    // `tierUpThreshold` times
+    bool tiered = false;
+    uint64_t tierUpThreshold = 1000;
+    unsigned tierUpOptLevel = 2;
+
+    // Count function entries and branch edges in every added function;
+    // JITEngine::GetProfile reads the counts for module.applyProfile
+    bool instrument = false;
+};
+
+struct JITEngineStats {
+    uint64_t modulesAdded;
+    uint64_t functionsAdded;
+    // Function bodies that actually reached the code generator
+    uint64_t functionsMaterialized;
+    uint64_t tierUps;
+    uint64_t tierUpFailures;
+    uint64_t cacheHits;
+    uint64_t cacheMisses;
+    uint64_t cacheEvictions;
+    uint64_t dedupeHits;
+    uint64_t dedupeMisses;
+    // Machine code size of the functions that did not have to be compiled
+    // again, known once their canonical copies have been compiled
+    uint64_t dedupeBytesSaved;
+    uint64_t modulesUnloaded;
+    // Bytes of code and data sections currently allocated by the linker
+    uint64_t liveCodeBytes;
+    uint64_t liveDataBytes;
+};
+
+struct JITTierInfo {
+    unsigned tier;
+    uint64_t calls;
+};
+
+// Section sizes allocated by the memory managers of the JIT linker. Shared
+// with the memory managers, which subtract their sections again when the
+// code they hold is removed.
+struct JITMemoryCounters {
+    std::atomic<int64_t> codeBytes{0};
+    std::atomic<int64_t> dataBytes{0};
+};
+
+class JITEngine;
+
+// Code and symbols of one added module, removed from the JIT together
+// through the module's resource tracker. Owned by the engine (unless the
+// module was added with `retain` false), the JS module handle and every
+// function handle bound to one of its definitions. The code is removed by
+// an explicit Unload or once the last owner lets go.
+class JITModuleState {
+public:
+    ~JITModuleState();
+
+    bool IsLoaded() const { return loaded_; }
+
+private:
+    friend class JITEngine;
+
+    std::weak_ptr<JITEngine> engine_;
+    llvm::orc::ResourceTrackerSP tracker_;
+    // Dylib holding the module in lazy mode, reexported by tracker_
+    llvm::orc::JITDylib* lazyDylib_ = nullptr;
+    // External definitions of the module
+    std::vector<std::string> names_;
+    // Call wrappers and batch loops compiled into the tracker for these
+    // definitions
+    std::vector<std::string> wrapperKeys_;
+    // Modules whose code deduplicated functions of this module alias, and
+    // the number of loaded modules aliasing code of this one
+    std::vector<std::shared_ptr<JITModuleState>> reused_;
+    unsigned reusedBy_ = 0;
+    // Counters of the functions instrumented for profiling
+    std::vector<ProfileLayout> profile_;
+    std::atomic<bool> loaded_{true};
+};
+
+// Owns the ORC LLJIT instance. Shared between the JS engine object and every
+// function handle so that compiled code stays alive while it can be called.
+class JITEngine : public std::enable_shared_from_this<JITEngine> {
+public:
+    static llvm::Expected<std::shared_ptr<JITEngine>> Create(const JITEngineOptions& options);
+    ~JITEngine();
+
+    // Takes ownership of the module and makes its definitions available
+    // under a resource tracker of their own. Unless `retain` is false the
+    // engine keeps the code alive until it is unloaded.
+    llvm::Expected<std::shared_ptr<JITModuleState>> AddModule(llvm::orc::ThreadSafeModule module,
+                                                              bool retain = true);
+
+    // Adds all modules and, unless the engine is lazy, compiles their
+    // definitions with a single lookup so that the compile threads can work
+    // on them at the same time
+    llvm::Expected<std::vector<std::shared_ptr<JITModuleState>>> AddModules(
+        std::vector<llvm::orc::ThreadSafeModule> modules, bool retain = true);
+
+    // Removes the code and symbols of the module right away. Fails while
+    // other loaded modules alias its functions. Calling into the module
+    // afterwards, also from other JIT code, is undefined.
+    llvm::Error Unload(const std::shared_ptr<JITModuleState>& module);
+
+    // Loaded module defining `name`, or null for host symbols
+    std::shared_ptr<JITModuleState> GetDefiningModule(const std::string& name);
+
+    // Compiles the named definitions now instead of on first use. In lazy
+    // mode this only resolves their stubs.
+    llvm::Error Materialize(const std::vector<std::string>& names);
+
+    JITEngineStats GetStats() const;
+
+    // Registers the engine so that other threads of the process can use its
+    // code; the same engine always gets the same id.
+    //
+    // Code compiles on the thread that first needs it, which for a shared
+    // engine may be a worker, while the thread that created a module keeps
+    // using its LLVMContext without any lock. So sharing first compiles
+    // whatever is still pending, on the calling thread, and modules added
+    // afterwards move to a context of their own. Lazy engines always do the
+    // latter, since their functions compile on first call.
+    llvm::Expected<uint64_t> Share();
+
+    // Engine registered under `id`, or null once it has been destroyed
+    static std::shared_ptr<JITEngine> FromShared(uint64_t id);
+
+    // Tier and call count of a function added in tiered mode
+    bool GetTierInfo(const std::string& name, JITTierInfo& info);
+
+    // Signature recorded for a function defined by an added module
+    bool GetSignature(const std::string& name, JITSignature& signature);
+
+    // Compiles (once per name and signature) the wrapper used to call `name`
+    llvm::Expected<JITCallWrapper> GetCallWrapper(const std::string& name,
+                                                  const JITSignature& signature);
+
+    // Native entry point of `name`, compiling it if needed
+    llvm::Expected<llvm::JITTargetAddress> GetFunctionAddress(const std::string& name);
+
+    // Compiles (once per name, signature and kind) a loop calling `name` for
+    // every row of a batch, inlining it when batchInlining kept its IR
+    llvm::Expected<JITBatchLoop> GetBatchLoop(const std::string& name, const JITSignature& signature,
+                                              JITBatchKind kind);
+
+    // Makes `name` resolve to a native address when JIT code is linked
+    llvm::Error DefineSymbol(const std::string& name, llvm::JITTargetAddress address);
+
+    // Resolves symbols no module defines against the exports of a shared
+    // library, or of the process itself when `path` is empty
+    llvm::Error AddLibrarySymbols(const std::string& path);
+
+    // Defines `name` as a function with `signature` that forwards its
+    // arguments to `function`. The engine keeps `context` alive.
+    llvm::Error DefineHostCallback(const std::string& name, const JITSignature& signature,
+                                   JITHostCallbackFn function, std::shared_ptr<void> context);
+
+    // Compiles the body of `name` in `module`, which may define nothing else
+    // but local helpers, and points the function's stub at it. Existing
+    // callers, JIT code included, switch over on their next call. Needs a
+    // redefinable or tiered engine.
+    llvm::Error Redefine(const std::string& name, llvm::orc::ThreadSafeModule module);
+
+    // Counts collected so far by the functions of loaded modules, in an
+    // engine created with `instrument`
+    llvm::Expected<ModuleProfile> GetProfile();
+    llvm::Error ResetProfile();
+
+private:
+    friend class JITModuleState;
+
+    // Per-function state of tiered compilation. Its address is baked into
+    // the tier 0 code, which bumps `calls` on every entry. Unloading drops
+    // the engine's reference; queued tier ups and running redefinitions
+    // keep it alive until they are done with it.
+    struct TieredFunction : std::enable_shared_from_this<TieredFunction> {
+        JITEngine* engine;
+        std::string name;
+        // Tracker of the defining module, which also owns the tier 1 code
+        llvm::orc::ResourceTrackerSP tracker;
+        // Bitcode of the defining module before instrumentation, used to
+        // rebuild the function in a fresh context for the optimized tier
+        std::shared_ptr<const std::string> bitcode;
+        // Printed function type that redefinitions have to match
+        std::string type;
+        std::atomic<uint64_t> calls;
+        std::atomic<unsigned> tier;
+        // Body installed by the latest Redefine, 0 for the original. A
+        // redefined function does not tier up any more.
+        std::atomic<uint64_t> version;
+        // Versions handed out by Redefine, guarded by mutex_
+        uint64_t versionsBuilt;
+    };
+
+    JITEngine(std::unique_ptr<DiskObjectCache> cache, std::unique_ptr<llvm::orc::LLJIT> jit,
+              const JITEngineOptions& options, llvm::orc::JITTargetMachineBuilder targetMachineBuilder,
+              std::shared_ptr<JITMemoryCounters> memory);
+
+    // Adds one module with mutex_ held, collecting its tiered functions.
+    // On failure the modules it already reused are moved to `released`.
+    llvm::Expected<std::shared_ptr<JITModuleState>> AddModuleLocked(
+        llvm::orc::ThreadSafeModule module, bool retain, std::vector<TieredFunction*>& tiered,
+        std::vector<std::shared_ptr<JITModuleState>>& released);
+    llvm::Expected<llvm::orc::SymbolMap> Lookup(const std::vector<std::string>& names);
+
+    // Removes the tracker of the module and forgets its definitions. Called
+    // by Unload and when the last owner of the module goes away.
+    llvm::Error RemoveModule(JITModuleState& module);
+
+    // The compile-on-demand layer puts the bodies it splits off under the
+    // default tracker of a companion dylib, out of reach of the module's
+    // tracker. Lazy modules therefore get a dylib of their own, reexported
+    // into the main dylib. Unloading clears it for reuse by later modules.
+    llvm::Error AddLazyModule(llvm::orc::ThreadSafeModule module, JITModuleState& state);
+    llvm::Error ClearLazyDylib(llvm::orc::JITDylib& dylib);
+
+    // Turns functions already compiled under another name into aliases of
+    // that name. Returns true if nothing in the module is left to compile.
+    // Functions seen for the first time go to `canonical`, which the caller
+    // merges into dedupedFunctions_ once the module has been added.
+    llvm::Expected<bool> DedupeFunctions(llvm::Module& module, JITModuleState& state,
+                                         std::map<std::string, std::string>& canonical);
+    void RecordSymbolSizes(const llvm::MemoryBuffer& object);
+
+    llvm::Error SetUpTiering();
+    llvm::Error PublishTier0(const std::vector<TieredFunction*>& tiered);
+    llvm::Error PrepareTiering(llvm::Module& module, JITModuleState& state,
+                               std::vector<TieredFunction*>& functions);
+    void InsertCallCounter(llvm::Function& function, TieredFunction& tiered);
+    llvm::Error TierUp(TieredFunction& function);
+    void RunTierUpThread();
+
+    // Called from tier 0 code when a function crosses the threshold
+    static void ScheduleTierUp(TieredFunction* function);
+
+    // Runs on every module (or lazily extracted partition) right before it
+    // is compiled
+    llvm::Expected<llvm::orc::ThreadSafeModule> TransformModule(
+        llvm::orc::ThreadSafeModule module, llvm::orc::MaterializationResponsibility& responsibility);
+
+    // Counter arrays of the instrumented functions of loaded modules
+    llvm::Expected<std::vector<std::pair<ProfileLayout, uint64_t*>>> GetProfileCounters();
+
+    llvm::orc::ThreadSafeModule BuildCallWrapper(const std::string& name,
+                                                 const std::string& wrapperName,
+                                                 const JITSignature& signature);
+
+    // Saves the bitcode of the functions batch loops may inline
+    void RecordBatchCallees(llvm::Module& module);
+    llvm::Expected<llvm::orc::ThreadSafeModule> BuildBatchLoop(const std::string& name,
+                                                               const std::string& loopName,
+                                                               const JITSignature& signature,
+                                                               JITBatchKind kind);
+
+    // Declared before the JIT, whose compilers use it, so that it outlives them
+    std::unique_ptr<DiskObjectCache> cache_;
+    std::unique_ptr<llvm::orc::LLJIT> jit_;
+    JITEngineOptions options_;
+    llvm::orc::JITTargetMachineBuilder targetMachineBuilder_;
+    std::mutex mutex_;
+    std::atomic<uint64_t> modulesAdded_;
+    std::atomic<uint64_t> functionsAdded_;
+    std::atomic<uint64_t> functionsMaterialized_;
+    std::atomic<uint64_t> tierUps_;
+    std::atomic<uint64_t> tierUpFailures_;
+    std::atomic<uint64_t> modulesUnloaded_;
+    std::shared_ptr<JITMemoryCounters> memory_;
+    std::map<std::string, JITSignature> signatures_;
+    std::map<std::string, JITCallWrapper> wrappers_;
+    std::map<std::string, JITBatchLoop> batchLoops_;
+    uint64_t wrappersBuilt_ = 0;
+    // Registry id, 0 while not shared; guarded by the registry's mutex
+    uint64_t sharedId_ = 0;
+    // Set by Share() before compiling what is pending, guarded by mutex_
+    bool shared_ = false;
+    // Bitcode holding the definition of each inlinable batch callee
+    std::map<std::string, std::shared_ptr<const std::string>> batchCallees_;
+    // Libraries searched for host symbols and the contexts of host
+    // callbacks, guarded by mutex_
+    std::set<std::string> hostLibraries_;
+    std::vector<std::shared_ptr<void>> hostCallbackContexts_;
+
+    // Modules kept alive by the engine itself, and the loaded module
+    // defining each name, guarded by mutex_
+    std::set<std::shared_ptr<JITModuleState>> retainedModules_;
+    std::map<std::string, std::weak_ptr<JITModuleState>> definingModules_;
+    std::vector<llvm::orc::JITDylib*> freeLazyDylibs_;
+    // Modules instrumented for profiling, guarded by mutex_
+    std::vector<std::weak_ptr<JITModuleState>> profiledModules_;
+    uint64_t lazyDylibsCreated_ = 0;
+
+    // Canonical function name by structural hash, guarded by mutex_
+    std::map<std::string, std::string> dedupedFunctions_;
+    // Guards the dedupe counters and symbol sizes, which compile threads
+    // update while mutex_ may be held by a lookup
+    mutable std::mutex dedupeMutex_;
+    uint64_t dedupeMisses_ = 0;
+    std::map<std::string, uint64_t> dedupeHitsByTarget_;
+    std::map<std::string, uint64_t> symbolSizes_;
+
+    std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_;
+    // Stubs cannot be freed, so one defined again reuses the slot of its
+    // name
+    std::map<std::string, std::shared_ptr<TieredFunction>> tieredFunctions_;
+    std::thread tierUpThread_;
+    std::mutex tierUpMutex_;
+    std::condition_variable tierUpCondition_;
+    std::deque<std::shared_ptr<TieredFunction>> tierUpQueue_;
+    // Held while tier 1 or redefined code is linked under the tracker of a
+    // loaded module, and while a module's tracker is removed: ORC must not
+    // free a module's code while linking into it
+    std::mutex trackerMutex_;
+    bool stopping_ = false;
+};
+
+// How one native parameter is filled from the JS arguments, decided once
+// when the function is bound
+struct JITParamBinding {
+    JITValueKind kind;
+    // Bit mask of napi_typedarray_type values accepted for pointer parameters
+    uint32_t arrayTypes;
+    // Index of the pointer parameter whose element count fills this
+    // parameter, or -1 if the value comes from a JS argument
+    int lengthOf;
+    // Index of the JS argument filling this parameter
+    uint32_t jsIndex;
+};
+
+// State behind a JS function returned by JITEngine.getFunction
+class JITFunction {
+public:
+    // Native callback calling `address` directly for a signature made of
+    // common kinds and at most three parameters, or null. Such callbacks
+    // are instantiated per signature and convert arguments without looking
+    // at their kinds.
+    static napi_callback FindTrampoline(const JITSignature& signature);
+
+    // Calls through `trampoline` and `address` when given, otherwise
+    // through the generic `wrapper`. With `lengthArgs`, an integer parameter
+    // directly following a pointer parameter is filled with the element
+    // count of the array passed for the pointer and is not part of the JS
+    // signature.
+    static Napi::Function Create(Napi::Env env, std::shared_ptr<JITEngine> engine,
+                                 std::shared_ptr<JITModuleState> module,
+                                 const std::string& name, const JITSignature& signature,
+                                 JITCallWrapper wrapper, napi_callback trampoline,
+                                 llvm::JITTargetAddress address, bool lengthArgs);
+
+private:
+    template <typename Ret, typename... Params>
+    friend struct JITTrampoline;
+
+    static Napi::Value Call(const Napi::CallbackInfo& info);
+
+    std::shared_ptr<JITEngine> engine_;
+    // Declared after the engine so that it is released first
+    std::shared_ptr<JITModuleState> module_;
+    JITSignature signature_;
+    std::vector<JITParamBinding> bindings_;
+    size_t jsArgCount_;
+    JITCallWrapper wrapper_;
+    void* address_;
+};
+
+// JS function exposed to JIT code through JITEngine.defineCallback. Calls
+// on the thread that registered it run synchronously; calls from any other
+// thread block until that thread has run the callback.
+class JITHostCallback {
+public:
+    static std::shared_ptr<JITHostCallback> Create(Napi::Env env, Napi::Function callback,
+                                                   const JITSignature& signature);
+    ~JITHostCallback();
+
+    static void Invoke(void* context, const JITSlot* args, JITSlot* ret);
+
+private:
+    // Shared with the finalizer of the thread-safe function, which runs on
+    // the registering thread when the engine releases it or when that
+    // thread's environment shuts down first
+    struct Target {
+        std::mutex mutex;
+        bool finalized = false;
+        Napi::FunctionReference callback;
+    };
+
+    void Run(Napi::Env env, Napi::Function callback, const JITSlot* args, JITSlot* ret);
+
+    napi_env env_;
+    std::thread::id thread_;
+    std::shared_ptr<Target> target_;
+    Napi::ThreadSafeFunction tsfn_;
+    JITSignature signature_;
+};
+
+// State behind fn.map and fn.reduce of a JS function returned by
+// JITEngine.getFunction. The loop is compiled on first use.
+class JITBatchFunction {
+public:
+    // Null if the signature cannot be run in a loop of this kind
+    static Napi::Value Create(Napi::Env env, std::shared_ptr<JITEngine> engine,
+                              std::shared_ptr<JITModuleState> module, const std::string& name,
+                              const JITSignature& signature, JITBatchKind kind);
+
+private:
+    static Napi::Value Call(const Napi::CallbackInfo& info);
+
+    std::shared_ptr<JITEngine> engine_;
+    std::shared_ptr<JITModuleState> module_;
+    std::string name_;
+    JITSignature signature_;
+    JITBatchKind kind_;
+    JITBatchLoop loop_;
+};
+
+class JITEngineWrapper : public Napi::ObjectWrap<JITEngineWrapper> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    JITEngineWrapper(const Napi::CallbackInfo& info);
+    static bool IsInstance(const Napi::Object& obj) {
+        return obj.InstanceOf(constructor.Value());
+    }
+
+    std::shared_ptr<JITEngine> GetEngine() const { return engine_; }
+
+private:
+    static thread_local Napi::FunctionReference constructor;
+
+    Napi::Value AddModule(const Napi::CallbackInfo& info);
+    Napi::Value AddModules(const Napi::CallbackInfo& info);
+    Napi::Value GetFunction(const Napi::CallbackInfo& info);
+    Napi::Value GetStats(const Napi::CallbackInfo& info);
+    Napi::Value GetProfile(const Napi::CallbackInfo& info);
+    Napi::Value ResetProfile(const Napi::CallbackInfo& info);
+    Napi::Value GetTierInfo(const Napi::CallbackInfo& info);
+    Napi::Value Share(const Napi::CallbackInfo& info);
+    Napi::Value ShareFunction(const Napi::CallbackInfo& info);
+    Napi::Value DefineSymbol(const Napi::CallbackInfo& info);
+    Napi::Value AddLibrary(const Napi::CallbackInfo& info);
+    Napi::Value DefineCallback(const Napi::CallbackInfo& info);
+    Napi::Value Redefine(const Napi::CallbackInfo& info);
+    static Napi::Value FromShared(const Napi::CallbackInfo& info);
+    static Napi::Value ImportFunction(const Napi::CallbackInfo& info);
+
+    std::shared_ptr<JITEngine> engine_;
+};
+
+// JS handle of a module added to a JITEngine
+class JITModuleWrapper : public Napi::ObjectWrap<JITModuleWrapper> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    static Napi::Object Create(Napi::Env env, std::shared_ptr<JITEngine> engine,
+                               std::shared_ptr<JITModuleState> module);
+    JITModuleWrapper(const Napi::CallbackInfo& info);
+
+private:
+    static thread_local Napi::FunctionReference constructor;
+
+    Napi::Value Unload(const Napi::CallbackInfo& info);
+    Napi::Value IsLoaded(const Napi::CallbackInfo& info);
+
+    std::shared_ptr<JITEngine> engine_;
+    std::shared_ptr<JITModuleState> module_;
+};
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,233 @@
+#include "llvm_linker.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/DiagnosticPrinter.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <functional>
+#include <vector>
+
+namespace llvm_nodejs {
+
+thread_local Napi::FunctionReference BitcodeLibraryWrapper::constructor;
+
+namespace {
+
+// The default handler of a context exits the process on errors, which is
+// how llvm::Linker reports conflicting definitions
+class LinkDiagnosticHandler : public llvm::DiagnosticHandler {
+public:
+    explicit LinkDiagnosticHandler(std::string& errors) : errors_(errors) {}
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+        if (info.getSeverity() == llvm::DS_Error) {
+            llvm::raw_string_ostream stream(errors_);
+            llvm::DiagnosticPrinterRawOStream printer(stream);
+            if (!errors_.empty()) {
+                stream << "\n";
+            }
+            info.print(printer);
+        }
+        return true;
+    }
+
+private:
+    std::string& errors_;
+};
+
+}  // namespace
+
+llvm::Error LinkModule(llvm::Module& destination, const llvm::Module& source, const LinkOptions& options) {
+    llvm::LLVMContext& context = destination.getContext();
+
+    // Bodies that were never read are left out rather than copied empty
+    llvm::ValueToValueMapTy valueMap;
+    std::unique_ptr<llvm::Module> copy = llvm::CloneModule(source, valueMap, [](const llvm::GlobalValue* global) {
+        return !global->isMaterializable();
+    });
+
+    // Modules of other contexts are copied over through bitcode
+    if (&source.getContext() != &context) {
+        std::string bitcode;
+        llvm::raw_string_ostream stream(bitcode);
+        llvm::WriteBitcodeToFile(*copy, stream);
+        stream.flush();
+        auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, source.getName()), context);
+        if (!parsed) {
+            return parsed.takeError();
+        }
+        copy = std::move(*parsed);
+    }
+
+    unsigned flags = options.onlyNeeded ? llvm::Linker::Flags::LinkOnlyNeeded : llvm::Linker::Flags::None;
+    std::function<void(llvm::Module&, const llvm::StringSet<>&)> internalize;
+    if (options.internalize) {
+        internalize = [](llvm::Module& module, const llvm::StringSet<>& linked) {
+            llvm::internalizeModule(module, [&linked](const llvm::GlobalValue& global) {
+                return !global.hasName() || !linked.count(global.getName());
+            });
+        };
+    }
+
+    std::string errors;
+    std::unique_ptr<llvm::DiagnosticHandler> previous = context.getDiagnosticHandler();
+    context.setDiagnosticHandler(std::make_unique<LinkDiagnosticHandler>(errors));
+    bool failed = llvm::Linker::linkModules(destination, std::move(copy), flags, internalize);
+    context.setDiagnosticHandler(std::move(previous));
+
+    if (failed) {
+        return llvm::make_error<llvm::StringError>(errors.empty() ? "Failed to link " + source.getName().str()
+                                                                  : errors,
+                                                   llvm::inconvertibleErrorCode());
+    }
+    return llvm::Error::success();
+}
+
+llvm::Error MaterializeNeeded(llvm::Module& library, const llvm::Module& destination) {
+    if (!library.getMaterializer()) {
+        return llvm::Error::success();
+    }
+    // Module flags and other named metadata are read lazily as well
+    if (llvm::Error err = library.materializeMetadata()) {
+        return err;
+    }
+
+    std::vector<llvm::GlobalValue*> worklist;
+    for (const llvm::GlobalValue& global : destination.global_values()) {
+        if (global.isDeclaration() && global.hasName()) {
+            if (llvm::GlobalValue* definition = library.getNamedValue(global.getName())) {
+                worklist.push_back(definition);
+            }
+        }
+    }
+
+    llvm::SmallPtrSet<const llvm::GlobalValue*, 32> materialized;
+    llvm::SmallPtrSet<const llvm::Constant*, 32> visitedConstants;
+    // Queues the globals a value refers to, looking through constant
+    // expressions and initializers
+    std::function<void(const llvm::Value*)> addReferences = [&](const llvm::Value* value) {
+        if (const llvm::GlobalValue* global = llvm::dyn_cast<llvm::GlobalValue>(value)) {
+            worklist.push_back(const_cast<llvm::GlobalValue*>(global));
+        } else if (const llvm::Constant* constant = llvm::dyn_cast<llvm::Constant>(value)) {
+            if (visitedConstants.insert(constant).second) {
+                for (const llvm::Value* operand : constant->operands()) {
+                    addReferences(operand);
+                }
+            }
+        }
+    };
+
+    while (!worklist.empty()) {
+        llvm::GlobalValue* global = worklist.back();
+        worklist.pop_back();
+        if (!materialized.insert(global).second) {
+            continue;
+        }
+        if (llvm::Error err = global->materialize()) {
+            return err;
+        }
+
+        if (llvm::Function* function = llvm::dyn_cast<llvm::Function>(global)) {
+            if (function->hasPersonalityFn()) {
+                addReferences(function->getPersonalityFn());
+            }
+            for (const llvm::Instruction& instruction : llvm::instructions(function)) {
+                for (const llvm::Value* operand : instruction.operands()) {
+                    addReferences(operand);
+                }
+            }
+        } else if (llvm::GlobalVariable* variable = llvm::dyn_cast<llvm::GlobalVariable>(global)) {
+            if (variable->hasInitializer()) {
+                addReferences(variable->getInitializer());
+            }
+        } else if (llvm::GlobalAlias* alias = llvm::dyn_cast<llvm::GlobalAlias>(global)) {
+            addReferences(alias->getAliasee());
+        } else if (llvm::GlobalIFunc* ifunc = llvm::dyn_cast<llvm::GlobalIFunc>(global)) {
+            addReferences(ifunc->getResolver());
+        }
+    }
+    return llvm::Error::success();
+}
+
+//
+// BitcodeLibraryWrapper implementation
+//
+BitcodeLibraryWrapper::BitcodeLibraryWrapper(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<BitcodeLibraryWrapper>(info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() == 2 && info[0].IsExternal() && info[1].IsExternal()) {
+        std::unique_ptr<llvm::orc::ThreadSafeContext> context(
+            info[0].As<Napi::External<llvm::orc::ThreadSafeContext>>().Data());
+        std::unique_ptr<std::shared_ptr<llvm::Module>> library(
+            info[1].As<Napi::External<std::shared_ptr<llvm::Module>>>().Data());
+        context_ = std::move(*context);
+        library_ = std::move(*library);
+    } else {
+        Napi::TypeError::New(env, "Use context.loadBitcodeLibrary() to load a BitcodeLibrary")
+            .ThrowAsJavaScriptException();
+    }
+}
+
+Napi::Object BitcodeLibraryWrapper::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "BitcodeLibrary", {
+        InstanceMethod("getFunctionNames", &BitcodeLibraryWrapper::GetFunctionNames)
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("BitcodeLibrary", func);
+    return exports;
+}
+
+Napi::Object BitcodeLibraryWrapper::Create(Napi::Env env, llvm::orc::ThreadSafeContext context,
+                                           std::shared_ptr<llvm::Module> library) {
+    return constructor.New({
+        Napi::External<llvm::orc::ThreadSafeContext>::New(env, new llvm::orc::ThreadSafeContext(std::move(context))),
+        Napi::External<std::shared_ptr<llvm::Module>>::New(
+            env, new std::shared_ptr<llvm::Module>(std::move(library)))
+    });
+}
+
+llvm::Expected<std::unique_ptr<llvm::Module>> BitcodeLibraryWrapper::Parse(
+    llvm::LLVMContext& context, std::unique_ptr<llvm::MemoryBuffer> bitcode) {
+    auto library = llvm::parseBitcodeFile(bitcode->getMemBufferRef(), context);
+    if (!library) {
+        return library.takeError();
+    }
+    // Fully materialized so that every link can copy from it
+    if (llvm::Error err = (*library)->materializeAll()) {
+        return err;
+    }
+    return library;
+}
+
+llvm::Expected<std::unique_ptr<llvm::Module>> BitcodeLibraryWrapper::ParseLazy(llvm::LLVMContext& context,
+                                                                               const std::string& path) {
+    // Without a null terminator requirement large files are mapped rather
+    // than read
+    auto file = llvm::MemoryBuffer::getFile(path, false, false);
+    if (!file) {
+        return llvm::errorCodeToError(file.getError());
+    }
+    return llvm::getOwningLazyBitcodeModule(std::move(*file), context, true);
+}
+
+Napi::Value BitcodeLibraryWrapper::GetFunctionNames(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Array names = Napi::Array::New(env);
+    for (const llvm::Function& function : *library_) {
+        if (!function.isDeclaration() && !function.hasLocalLinkage()) {
+            names.Set(names.Length(), Napi::String::New(env, function.getName().str()));
+        }
+    }
+    return names;
+}
+
+}  // namespace llvm_nodejs
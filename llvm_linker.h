@@ -0,0 +1,69 @@
+#pragma once
+
+#include <napi.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <memory>
+#include <string>
+
+namespace llvm_nodejs {
+
+struct LinkOptions {
+    // Only bring in the definitions `destination` references, as for a
+    // library
+    bool onlyNeeded = false;
+    // Give everything that came from the source internal linkage so that
+    // the optimizer can inline it and drop what is left unused
+    bool internalize = false;
+};
+
+// Links a copy of `source` into `destination` with llvm::Linker. `source`
+// is left untouched and may live in another context. Functions of a lazily
+// loaded `source` whose bodies were never read are copied as declarations.
+// Fails on conflicting definitions; `destination` may then be partially
+// linked.
+llvm::Error LinkModule(llvm::Module& destination, const llvm::Module& source, const LinkOptions& options);
+
+// Reads the bodies of the functions of a lazily loaded `library` that
+// `destination` calls, and of everything those reach in turn. No-op for a
+// fully materialized library.
+llvm::Error MaterializeNeeded(llvm::Module& library, const llvm::Module& destination);
+
+// Parsed bitcode of a runtime library, e.g. helpers written in C and built
+// with `clang -c -emit-llvm`. module.link(library) links in the functions
+// the module calls, internalized so that they can be inlined. Libraries
+// loaded lazily read function bodies only when a link first needs them.
+class BitcodeLibraryWrapper : public Napi::ObjectWrap<BitcodeLibraryWrapper> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    static Napi::Object Create(Napi::Env env, llvm::orc::ThreadSafeContext context,
+                               std::shared_ptr<llvm::Module> library);
+    static bool IsInstance(const Napi::Object& obj) {
+        return obj.InstanceOf(constructor.Value());
+    }
+
+    BitcodeLibraryWrapper(const Napi::CallbackInfo& info);
+    llvm::Module& GetModule() const { return *library_; }
+
+    // Reads a bitcode file or buffer into `context`
+    static llvm::Expected<std::unique_ptr<llvm::Module>> Parse(llvm::LLVMContext& context,
+                                                              std::unique_ptr<llvm::MemoryBuffer> bitcode);
+
+    // Memory-maps the bitcode file at `path` and reads only declarations.
+    // The mapping lives as long as the module, which reads function bodies
+    // from it on demand.
+    static llvm::Expected<std::unique_ptr<llvm::Module>> ParseLazy(llvm::LLVMContext& context,
+                                                                  const std::string& path);
+
+private:
+    static thread_local Napi::FunctionReference constructor;
+
+    Napi::Value GetFunctionNames(const Napi::CallbackInfo& info);
+
+    // Declared first so that the library is destroyed before its context
+    llvm::orc::ThreadSafeContext context_;
+    std::shared_ptr<llvm::Module> library_;
+};
+
+}  // namespace llvm_nodejs
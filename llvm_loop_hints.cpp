@@ -0,0 +1,216 @@
+#include "llvm_loop_hints.h"
+#include "llvm_builder.h"
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Type.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm_nodejs {
+
+namespace {
+
+// JS property, loop metadata name and how the value is encoded
+enum class HintKind { Bool, Count, Flag };
+
+struct LoopHint {
+    const char* property;
+    const char* metadata;
+    HintKind kind;
+};
+
+const LoopHint loopHints[] = {
+    {"vectorize", "llvm.loop.vectorize.enable", HintKind::Bool},
+    {"vectorizeWidth", "llvm.loop.vectorize.width", HintKind::Count},
+    {"interleaveCount", "llvm.loop.interleave.count", HintKind::Count},
+    {"unrollCount", "llvm.loop.unroll.count", HintKind::Count},
+    {"unrollFull", "llvm.loop.unroll.full", HintKind::Flag},
+    {"mustProgress", "llvm.loop.mustprogress", HintKind::Flag},
+};
+
+const char* const parallelAccessesName = "llvm.loop.parallel_accesses";
+const char* const unrollEnableName = "llvm.loop.unroll.enable";
+const char* const unrollDisableName = "llvm.loop.unroll.disable";
+const char* const isVectorizedName = "llvm.loop.isvectorized";
+
+llvm::StringRef HintName(const llvm::MDOperand& operand) {
+    const llvm::MDNode* node = llvm::dyn_cast<llvm::MDNode>(operand);
+    if (!node || node->getNumOperands() == 0) {
+        return llvm::StringRef();
+    }
+    const llvm::MDString* name = llvm::dyn_cast<llvm::MDString>(node->getOperand(0));
+    return name ? name->getString() : llvm::StringRef();
+}
+
+llvm::Metadata* HintValue(const llvm::MDNode* hint) {
+    return hint->getNumOperands() > 1 ? hint->getOperand(1).get() : nullptr;
+}
+
+}  // namespace
+
+llvm::Value* CreateAccessGroup(llvm::LLVMContext& context) {
+    return llvm::MetadataAsValue::get(context, llvm::MDNode::getDistinct(context, {}));
+}
+
+llvm::MDNode* GetAccessGroup(llvm::Value* value) {
+    llvm::MetadataAsValue* wrapped = llvm::dyn_cast_or_null<llvm::MetadataAsValue>(value);
+    if (!wrapped) {
+        return nullptr;
+    }
+    llvm::MDNode* node = llvm::dyn_cast<llvm::MDNode>(wrapped->getMetadata());
+    return node && node->isDistinct() && node->getNumOperands() == 0 ? node : nullptr;
+}
+
+bool SetLoopHints(Napi::Env env, llvm::Instruction* branch, const Napi::Object& hints) {
+    llvm::LLVMContext& context = branch->getContext();
+    llvm::Type* int32Type = llvm::Type::getInt32Ty(context);
+
+    // Build the new hints first so that invalid input leaves the branch as is
+    std::vector<llvm::Metadata*> updated;
+    std::vector<std::string> replaced;
+    for (const LoopHint& hint : loopHints) {
+        Napi::Value value = hints.Get(hint.property);
+        if (value.IsUndefined()) {
+            continue;
+        }
+        replaced.push_back(hint.metadata);
+
+        llvm::MDString* name = llvm::MDString::get(context, hint.metadata);
+        switch (hint.kind) {
+        case HintKind::Bool:
+            if (!value.IsBoolean()) {
+                Napi::TypeError::New(env, std::string(hint.property) + " must be a boolean")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+            updated.push_back(llvm::MDNode::get(context, {name, llvm::ConstantAsMetadata::get(
+                llvm::ConstantInt::get(llvm::Type::getInt1Ty(context), value.As<Napi::Boolean>().Value()))}));
+            break;
+        case HintKind::Count: {
+            // Stored as i32 metadata, so anything larger would wrap
+            double count = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : 0;
+            if (count < 1 || count > UINT32_MAX || std::floor(count) != count) {
+                Napi::TypeError::New(env, std::string(hint.property) + " must be a positive 32-bit integer")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+            updated.push_back(llvm::MDNode::get(context, {name, llvm::ConstantAsMetadata::get(
+                llvm::ConstantInt::get(int32Type, static_cast<uint32_t>(count)))}));
+            break;
+        }
+        case HintKind::Flag:
+            if (!value.IsBoolean()) {
+                Napi::TypeError::New(env, std::string(hint.property) + " must be a boolean")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+            if (value.As<Napi::Boolean>().Value()) {
+                updated.push_back(llvm::MDNode::get(context, {name}));
+            }
+            break;
+        }
+    }
+
+    // unroll: true/false is spelled as two separate flags
+    Napi::Value unroll = hints.Get("unroll");
+    if (!unroll.IsUndefined()) {
+        if (!unroll.IsBoolean()) {
+            Napi::TypeError::New(env, "unroll must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        replaced.push_back(unrollEnableName);
+        replaced.push_back(unrollDisableName);
+        const char* name = unroll.As<Napi::Boolean>().Value() ? unrollEnableName : unrollDisableName;
+        updated.push_back(llvm::MDNode::get(context, {llvm::MDString::get(context, name)}));
+    }
+
+    Napi::Value parallelAccesses = hints.Get("parallelAccesses");
+    if (!parallelAccesses.IsUndefined()) {
+        if (!parallelAccesses.IsArray()) {
+            Napi::TypeError::New(env, "parallelAccesses must be an array of access groups")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        Napi::Array groups = parallelAccesses.As<Napi::Array>();
+        std::vector<llvm::Metadata*> operands = {llvm::MDString::get(context, parallelAccessesName)};
+        for (uint32_t i = 0; i < groups.Length(); i++) {
+            llvm::MDNode* group = GetAccessGroup(IRBuilderWrapper::UnwrapValue(groups.Get(i)));
+            if (!group) {
+                Napi::TypeError::New(env, "Invalid access group at index " + std::to_string(i))
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+            operands.push_back(group);
+        }
+        replaced.push_back(parallelAccessesName);
+        if (operands.size() > 1) {
+            updated.push_back(llvm::MDNode::get(context, operands));
+        }
+    }
+
+    // The loop ID is a distinct node whose first operand refers to itself
+    std::vector<llvm::Metadata*> operands = {nullptr};
+    if (llvm::MDNode* previous = branch->getMetadata(llvm::LLVMContext::MD_loop)) {
+        for (unsigned i = 1; i < previous->getNumOperands(); i++) {
+            llvm::StringRef name = HintName(previous->getOperand(i));
+            if (std::find(replaced.begin(), replaced.end(), name.str()) == replaced.end()) {
+                operands.push_back(previous->getOperand(i));
+            }
+        }
+    }
+    operands.insert(operands.end(), updated.begin(), updated.end());
+
+    llvm::MDNode* loopID = llvm::MDNode::getDistinct(context, operands);
+    loopID->replaceOperandWith(0, loopID);
+    branch->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+    return true;
+}
+
+Napi::Value GetLoopHints(Napi::Env env, const llvm::Instruction* branch) {
+    llvm::MDNode* loopID = branch->getMetadata(llvm::LLVMContext::MD_loop);
+    if (!loopID) {
+        return env.Null();
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    for (unsigned i = 1; i < loopID->getNumOperands(); i++) {
+        llvm::StringRef name = HintName(loopID->getOperand(i));
+        const llvm::MDNode* hint = llvm::dyn_cast_or_null<llvm::MDNode>(loopID->getOperand(i).get());
+        if (name.empty()) {
+            continue;
+        }
+
+        for (const LoopHint& known : loopHints) {
+            if (name != known.metadata) {
+                continue;
+            }
+            llvm::ConstantInt* value = llvm::mdconst::dyn_extract_or_null<llvm::ConstantInt>(HintValue(hint));
+            if (known.kind == HintKind::Flag) {
+                result.Set(known.property, Napi::Boolean::New(env, true));
+            } else if (known.kind == HintKind::Bool && value) {
+                result.Set(known.property, Napi::Boolean::New(env, !value->isZero()));
+            } else if (value) {
+                result.Set(known.property, Napi::Number::New(env, static_cast<double>(value->getZExtValue())));
+            }
+        }
+
+        if (name == unrollEnableName || name == unrollDisableName) {
+            result.Set("unroll", Napi::Boolean::New(env, name == unrollEnableName));
+        } else if (name == isVectorizedName) {
+            result.Set("isVectorized", Napi::Boolean::New(env, true));
+        } else if (name == parallelAccessesName) {
+            Napi::Array groups = Napi::Array::New(env, hint->getNumOperands() - 1);
+            for (unsigned j = 1; j < hint->getNumOperands(); j++) {
+                groups.Set(j - 1, ValueWrapper::Create(env, llvm::MetadataAsValue::get(
+                    branch->getContext(), hint->getOperand(j).get())));
+            }
+            result.Set("parallelAccesses", groups);
+        }
+    }
+    return result;
+}
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <napi.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Metadata.h>
+
+namespace llvm_nodejs {
+
+// A fresh access group, wrapped as a Value so that it can be passed around
+// in JS like any other IR handle
+llvm::Value* CreateAccessGroup(llvm::LLVMContext& context);
+
+// Returns the access group wrapped by `value`, or null if it is not one
+llvm::MDNode* GetAccessGroup(llvm::Value* value);
+
+// Attaches `llvm.loop` metadata built from
+// { vectorize, vectorizeWidth, interleaveCount, unroll, unrollCount,
+//   unrollFull, parallelAccesses: [group, ...], mustProgress }
+// to the back-edge branch of a loop. Properties not mentioned keep their
+// previous value. Throws and returns false on invalid input.
+bool SetLoopHints(Napi::Env env, llvm::Instruction* branch, const Napi::Object& hints);
+
+// Reads the `llvm.loop` metadata of a branch back into the same shape, plus
+// `isVectorized` once the loop vectorizer has run. Null without metadata.
+Napi::Value GetLoopHints(Napi::Env env, const llvm::Instruction* branch);
+
+}  // namespace llvm_nodejs
@@ -1,14 +1,65 @@
 #include "llvm_module.h"
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Argument.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <map>
 #include "llvm_types.h"
 #include "llvm_function.h"
 #include <llvm/Support/raw_ostream.h>
 #include "llvm_builder.h"
+#include "llvm_async.h"
+#include "llvm_jit.h"
+#include "llvm_linker.h"
+#include "llvm_passes.h"
+#include "llvm_print.h"
+#include "llvm_profile.h"
+#include "llvm_target.h"
+#include "llvm_target_machine.h"
 
 namespace llvm_nodejs {
 
 // Initialize the static constructor reference
-Napi::FunctionReference ModuleWrapper::constructor;
+thread_local Napi::FunctionReference ModuleWrapper::constructor;
+
+// Handles of the modules owned by the ModuleWrappers of this thread
+static thread_local std::map<const llvm::Module*, std::shared_ptr<ModuleHandle>> moduleHandles;
+
+std::shared_ptr<ModuleHandle> GetModuleHandle(const llvm::Value* value) {
+    const llvm::Module* module = nullptr;
+    if (const llvm::GlobalValue* global = llvm::dyn_cast<llvm::GlobalValue>(value)) {
+        module = global->getParent();
+    } else if (const llvm::Argument* argument = llvm::dyn_cast<llvm::Argument>(value)) {
+        module = argument->getParent()->getParent();
+    } else if (const llvm::BasicBlock* block = llvm::dyn_cast<llvm::BasicBlock>(value)) {
+        module = block->getParent() ? block->getModule() : nullptr;
+    } else if (const llvm::Instruction* instruction = llvm::dyn_cast<llvm::Instruction>(value)) {
+        return instruction->getParent() ? GetModuleHandle(instruction->getParent()) : nullptr;
+    }
+
+    auto handle = moduleHandles.find(module);
+    return handle != moduleHandles.end() ? handle->second : nullptr;
+}
+
+bool CheckModuleHandle(Napi::Env env, const std::shared_ptr<ModuleHandle>& handle) {
+    if (handle && handle->taken) {
+        Napi::Error::New(env, "Module of this IR has been handed over to a JIT engine").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (handle && handle->destroyed) {
+        Napi::Error::New(env, "Module of this IR has been garbage collected").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+bool CheckModuleIR(Napi::Env env, const std::shared_ptr<ModuleHandle>& handle, const llvm::Value* value,
+                   bool modify) {
+    if (!CheckModuleHandle(env, handle)) {
+        return false;
+    }
+    return !modify || CheckContextUnlocked(env, value->getContext());
+}
 
 ModuleWrapper::ModuleWrapper(const Napi::CallbackInfo& info) 
     : Napi::ObjectWrap<ModuleWrapper>(info) {
@@ -16,18 +67,49 @@ ModuleWrapper::ModuleWrapper(const Napi::CallbackInfo& info)
     
     // This constructor should not be called directly from JavaScript
     if (info.Length() == 1 && info[0].IsExternal()) {
-        // Unwrap the module pointer passed from Create()
-        module_ = std::unique_ptr<llvm::Module>(
-            static_cast<llvm::Module*>(info[0].As<Napi::External<llvm::Module>>().Data()));
+        // Take over the module passed from Create()
+        std::unique_ptr<llvm::orc::ThreadSafeModule> module(
+            info[0].As<Napi::External<llvm::orc::ThreadSafeModule>>().Data());
+        module_ = std::move(*module);
+        handle_ = std::make_shared<ModuleHandle>();
+        moduleHandles[GetModule()] = handle_;
     } else {
         Napi::TypeError::New(env, "ModuleWrapper constructor is not meant to be called directly")
             .ThrowAsJavaScriptException();
     }
 }
 
-Napi::Object ModuleWrapper::Create(Napi::Env env, std::unique_ptr<llvm::Module> module) {
+ModuleWrapper::~ModuleWrapper() {
+    ReleaseHandle();
+    if (handle_) {
+        handle_->destroyed = true;
+    }
+}
+
+llvm::orc::ThreadSafeModule ModuleWrapper::TakeModule() {
+    ReleaseHandle();
+    if (handle_) {
+        handle_->taken = true;
+    }
+    return std::move(module_);
+}
+
+void ModuleWrapper::ReturnModule(llvm::orc::ThreadSafeModule module) {
+    module_ = std::move(module);
+    handle_->taken = false;
+    moduleHandles[GetModule()] = handle_;
+}
+
+void ModuleWrapper::ReleaseHandle() {
+    if (GetModule()) {
+        moduleHandles.erase(GetModule());
+    }
+}
+
+Napi::Object ModuleWrapper::Create(Napi::Env env, llvm::orc::ThreadSafeModule module) {
     // Create an external reference to pass ownership of the module
-    Napi::External<llvm::Module> external = Napi::External<llvm::Module>::New(env, module.release());
+    Napi::External<llvm::orc::ThreadSafeModule> external = Napi::External<llvm::orc::ThreadSafeModule>::New(
+        env, new llvm::orc::ThreadSafeModule(std::move(module)));
     
     // Call the constructor with the external reference
     Napi::Object obj = constructor.New({ external });
@@ -40,10 +122,24 @@ Napi::Object ModuleWrapper::Init(Napi::Env env, Napi::Object exports) {
         InstanceMethod("getName", &ModuleWrapper::GetModuleName),
         InstanceMethod("setName", &ModuleWrapper::SetModuleName),
         InstanceMethod("dump", &ModuleWrapper::Dump),
+        InstanceMethod("printTo", &ModuleWrapper::PrintTo),
+        InstanceMethod("toBitcode", &ModuleWrapper::ToBitcode),
         InstanceMethod("setTargetTriple", &ModuleWrapper::SetTargetTriple),
         InstanceMethod("setDataLayout", &ModuleWrapper::SetDataLayout),
+        InstanceMethod("setTarget", &ModuleWrapper::SetTarget),
         InstanceMethod("createFunction", &ModuleWrapper::CreateFunction),
-        InstanceMethod("verify", &ModuleWrapper::Verify)
+        InstanceMethod("verify", &ModuleWrapper::Verify),
+        InstanceMethod("optimize", &ModuleWrapper::Optimize),
+        InstanceMethod("applyProfile", &ModuleWrapper::ApplyProfile),
+        InstanceMethod("link", &ModuleWrapper::Link),
+        InstanceMethod("emitObject", &ModuleWrapper::EmitObject),
+        InstanceMethod("emitAssembly", &ModuleWrapper::EmitAssembly),
+        InstanceMethod("runPasses", &ModuleWrapper::RunPasses),
+        InstanceMethod("verifyAsync", &ModuleWrapper::VerifyAsync),
+        InstanceMethod("optimizeAsync", &ModuleWrapper::OptimizeAsync),
+        InstanceMethod("compileAsync", &ModuleWrapper::CompileAsync),
+        InstanceMethod("emitObjectAsync", &ModuleWrapper::EmitObjectAsync),
+        InstanceMethod("emitAssemblyAsync", &ModuleWrapper::EmitAssemblyAsync)
     });
 
     // Store the constructor for later use in Create()
@@ -54,13 +150,28 @@ Napi::Object ModuleWrapper::Init(Napi::Env env, Napi::Object exports) {
     return exports;
 }
 
+bool ModuleWrapper::CheckModule(Napi::Env env) {
+    if (!GetModule()) {
+        Napi::Error::New(env, "Module has been handed over to a JIT engine")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    return CheckContextUnlocked(env, GetModule()->getContext());
+}
+
 Napi::Value ModuleWrapper::GetModuleName(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    return Napi::String::New(env, module_->getName().str());
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+    return Napi::String::New(env, GetModule()->getName().str());
 }
 
 Napi::Value ModuleWrapper::SetModuleName(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsString()) {
         Napi::TypeError::New(env, "String expected").ThrowAsJavaScriptException();
@@ -68,24 +179,57 @@ Napi::Value ModuleWrapper::SetModuleName(const Napi::CallbackInfo& info) {
     }
     
     std::string name = info[0].As<Napi::String>().Utf8Value();
-    module_->setModuleIdentifier(name);
+    GetModule()->setModuleIdentifier(name);
     
     return env.Undefined();
 }
 
 Napi::Value ModuleWrapper::Dump(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
     
     // Dump the module to string and return it
     std::string str;
     llvm::raw_string_ostream stream(str);
-    module_->print(stream, nullptr);
+    GetModule()->print(stream, nullptr);
     
     return Napi::String::New(env, str);
 }
 
+// printTo(fd | callback | writable, { chunkSize }) prints like dump() but
+// streams the text, so large modules never exist as one string
+Napi::Value ModuleWrapper::PrintTo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    llvm::Module* module = GetModule();
+    llvm_nodejs::PrintTo(info, [module](llvm::raw_ostream& stream) { module->print(stream, nullptr); });
+    return env.Undefined();
+}
+
+// toBitcode() serializes the module for caching or for handing it to
+// another process, where context.parseBitcode() reads it back
+Napi::Value ModuleWrapper::ToBitcode(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream(bitcode);
+    llvm::WriteBitcodeToFile(*GetModule(), stream);
+    return Napi::Buffer<char>::Copy(env, bitcode.data(), bitcode.size());
+}
+
 Napi::Value ModuleWrapper::SetTargetTriple(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsString()) {
         Napi::TypeError::New(env, "String expected").ThrowAsJavaScriptException();
@@ -93,13 +237,17 @@ Napi::Value ModuleWrapper::SetTargetTriple(const Napi::CallbackInfo& info) {
     }
     
     std::string triple = info[0].As<Napi::String>().Utf8Value();
-    module_->setTargetTriple(triple);
+    GetModule()->setTargetTriple(triple);
+    handle_->targetOptions.reset();
     
     return env.Undefined();
 }
 
 Napi::Value ModuleWrapper::SetDataLayout(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 1 || !info[0].IsString()) {
         Napi::TypeError::New(env, "String expected").ThrowAsJavaScriptException();
@@ -107,13 +255,44 @@ Napi::Value ModuleWrapper::SetDataLayout(const Napi::CallbackInfo& info) {
     }
     
     std::string layout = info[0].As<Napi::String>().Utf8Value();
-    module_->setDataLayout(layout);
+    GetModule()->setDataLayout(layout);
     
     return env.Undefined();
 }
 
+// setTarget(tm) takes the triple and data layout from a TargetMachine and
+// tags every function with its CPU and features
+Napi::Value ModuleWrapper::SetTarget(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    if (info.Length() < 1 || !info[0].IsObject() ||
+        !TargetMachineWrapper::IsInstance(info[0].As<Napi::Object>())) {
+        Napi::TypeError::New(env, "TargetMachine argument expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    TargetMachineWrapper* targetWrapper = Napi::ObjectWrap<TargetMachineWrapper>::Unwrap(info[0].As<Napi::Object>());
+
+    llvm::Module* module = GetModule();
+    module->setTargetTriple(targetWrapper->GetTargetMachine()->getTargetTriple().str());
+    module->setDataLayout(targetWrapper->GetTargetMachine()->createDataLayout());
+    handle_->targetOptions = targetWrapper->GetOptions();
+    for (llvm::Function& function : *module) {
+        if (!function.isDeclaration()) {
+            SetFunctionTarget(function, *handle_->targetOptions);
+        }
+    }
+
+    return env.Undefined();
+}
+
 Napi::Value ModuleWrapper::CreateFunction(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
     
     if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
         Napi::TypeError::New(env, "Expected function name and function type").ThrowAsJavaScriptException();
@@ -127,19 +306,25 @@ Napi::Value ModuleWrapper::CreateFunction(const Napi::CallbackInfo& info) {
         typeWrapper->GetFunctionType(),
         llvm::Function::ExternalLinkage,
         name,
-        module_.get()
+        GetModule()
     );
+    if (handle_->targetOptions) {
+        SetFunctionTarget(*function, *handle_->targetOptions);
+    }
     
     return FunctionWrapper::Create(env, function);
 }
 
 Napi::Value ModuleWrapper::Verify(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
     
     std::string errorStr;
     llvm::raw_string_ostream errorStream(errorStr);
     
-    bool isValid = !llvm::verifyModule(*module_, &errorStream);
+    bool isValid = !llvm::verifyModule(*GetModule(), &errorStream);
     
     Napi::Object result = Napi::Object::New(env);
     result.Set("valid", Napi::Boolean::New(env, isValid));
@@ -153,4 +338,365 @@ Napi::Value ModuleWrapper::Verify(const Napi::CallbackInfo& info) {
 
 }
 
+// Reads either an optimization level (0-3 or "O0", "O1", "O2", "O3", "Os",
+// "Oz") or { level, vectorize, unroll }. Throws and returns false on invalid
+// input.
+static bool ParseOptimizationOptions(Napi::Env env, const Napi::CallbackInfo& info,
+                                     OptimizationOptions& options) {
+    Napi::Value levelValue = env.Undefined();
+    if (info.Length() > 0 && (info[0].IsNumber() || info[0].IsString())) {
+        levelValue = info[0];
+    } else if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object optionsObj = info[0].As<Napi::Object>();
+        levelValue = optionsObj.Get("level");
+        Napi::Value vectorize = optionsObj.Get("vectorize");
+        if (!vectorize.IsUndefined()) {
+            options.vectorize = vectorize.ToBoolean();
+        }
+        Napi::Value unroll = optionsObj.Get("unroll");
+        if (!unroll.IsUndefined()) {
+            options.unroll = unroll.ToBoolean();
+        }
+    }
+
+    if (levelValue.IsNumber()) {
+        unsigned level = levelValue.As<Napi::Number>().Uint32Value();
+        if (level > 3) {
+            Napi::RangeError::New(env, "Optimization level must be 0-3").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.level = OptimizationLevelFromNumber(level);
+    } else if (levelValue.IsString()) {
+        if (!OptimizationLevelFromName(levelValue.As<Napi::String>().Utf8Value(), options.level)) {
+            Napi::RangeError::New(env, "Optimization level must be one of O0, O1, O2, O3, Os, Oz")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    return true;
+}
+
+Napi::Value ModuleWrapper::Optimize(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    OptimizationOptions options;
+    if (!ParseOptimizationOptions(env, info, options)) {
+        return env.Undefined();
+    }
+
+    // The target machine only feeds cost models, so optimize without one if
+    // the module targets something we cannot create
+    auto targetMachine = handle_->targetOptions ? CreateTargetMachine(*handle_->targetOptions)
+                                                : CreateTargetMachineForModule(*GetModule());
+    if (!targetMachine) {
+        llvm::consumeError(targetMachine.takeError());
+        OptimizeModule(*GetModule(), options);
+    } else {
+        OptimizeModule(*GetModule(), options, targetMachine->get());
+    }
+    return env.Undefined();
+}
+
+void ThrowPassPipelineError(Napi::Env env, const std::string& pipeline, llvm::Error err) {
+    std::string reason = llvm::toString(std::move(err));
+    Napi::Error error = Napi::Error::New(env, "Invalid pass pipeline: " + reason);
+    error.Value().Set("code", Napi::String::New(env, "ERR_LLVM_PASS_PIPELINE"));
+    error.Value().Set("pipeline", Napi::String::New(env, pipeline));
+    error.Value().Set("reason", Napi::String::New(env, reason));
+    error.ThrowAsJavaScriptException();
+}
+
+// runPasses("function(mem2reg,instcombine),globaldce") runs a pipeline in
+// the syntax of `opt -passes=` on the whole module
+Napi::Value ModuleWrapper::RunPasses(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Pass pipeline string expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::string pipeline = info[0].As<Napi::String>().Utf8Value();
+
+    auto targetMachine = handle_->targetOptions ? CreateTargetMachine(*handle_->targetOptions)
+                                                : CreateTargetMachineForModule(*GetModule());
+    if (!targetMachine) {
+        llvm::consumeError(targetMachine.takeError());
+    }
+    if (llvm::Error err = RunPassPipeline(*GetModule(), pipeline,
+                                          targetMachine ? targetMachine->get() : nullptr)) {
+        ThrowPassPipelineError(env, pipeline, std::move(err));
+    }
+    return env.Undefined();
+}
+
+// link(module | library, { onlyNeeded, internalize }) links a copy of the
+// other module into this one; the other module stays usable. Libraries
+// default to linking only what this module references, internalized.
+Napi::Value ModuleWrapper::Link(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Module or BitcodeLibrary argument expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object sourceObj = info[0].As<Napi::Object>();
+
+    const llvm::Module* source = nullptr;
+    LinkOptions options;
+    if (BitcodeLibraryWrapper::IsInstance(sourceObj)) {
+        BitcodeLibraryWrapper* library = Napi::ObjectWrap<BitcodeLibraryWrapper>::Unwrap(sourceObj);
+        if (!CheckContextUnlocked(env, library->GetModule().getContext())) {
+            return env.Undefined();
+        }
+        // Lazily loaded libraries read the bodies this module calls now
+        if (llvm::Error err = MaterializeNeeded(library->GetModule(), *GetModule())) {
+            Napi::Error::New(env, "Failed to read bitcode library: " + llvm::toString(std::move(err)))
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        source = &library->GetModule();
+        options.onlyNeeded = true;
+        options.internalize = true;
+    } else if (IsInstance(sourceObj)) {
+        ModuleWrapper* other = Napi::ObjectWrap<ModuleWrapper>::Unwrap(sourceObj);
+        if (other == this) {
+            Napi::Error::New(env, "Cannot link a module into itself").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!other->CheckModule(env)) {
+            return env.Undefined();
+        }
+        source = other->GetModule();
+    } else {
+        Napi::TypeError::New(env, "Module or BitcodeLibrary argument expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object optionsObj = info[1].As<Napi::Object>();
+        if (optionsObj.Has("onlyNeeded")) {
+            options.onlyNeeded = optionsObj.Get("onlyNeeded").ToBoolean();
+        }
+        if (optionsObj.Has("internalize")) {
+            options.internalize = optionsObj.Get("internalize").ToBoolean();
+        }
+    }
+
+    if (llvm::Error err = LinkModule(*GetModule(), *source, options)) {
+        Napi::Error::New(env, "Failed to link: " + llvm::toString(std::move(err))).ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// Reads { threads }. More than one thread splits the module and generates
+// code for the parts in parallel. Throws and returns false on invalid input.
+static bool ParseEmitOptions(Napi::Env env, const Napi::CallbackInfo& info, unsigned& threads) {
+    threads = 1;
+    if (info.Length() < 1 || info[0].IsUndefined()) {
+        return true;
+    }
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Options object expected").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Value threadsValue = info[0].As<Napi::Object>().Get("threads");
+    if (threadsValue.IsUndefined()) {
+        return true;
+    }
+    if (!threadsValue.IsNumber() || threadsValue.As<Napi::Number>().DoubleValue() < 1) {
+        Napi::RangeError::New(env, "threads must be a positive number").ThrowAsJavaScriptException();
+        return false;
+    }
+    threads = threadsValue.As<Napi::Number>().Uint32Value();
+    return true;
+}
+
+// emitObject({ threads }) and emitAssembly({ threads }) return a Buffer, or
+// with more than one thread an array of Buffers, one per module part
+Napi::Value ModuleWrapper::EmitObject(const Napi::CallbackInfo& info) {
+    return Emit(info, llvm::CGFT_ObjectFile);
+}
+
+Napi::Value ModuleWrapper::EmitAssembly(const Napi::CallbackInfo& info) {
+    return Emit(info, llvm::CGFT_AssemblyFile);
+}
+
+Napi::Value ModuleWrapper::Emit(const Napi::CallbackInfo& info, llvm::CodeGenFileType fileType) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    unsigned threads;
+    if (!ParseEmitOptions(env, info, threads)) {
+        return env.Undefined();
+    }
+
+    // Code generation lowers IR in place, so work on a copy
+    TargetMachineOptions options = handle_->targetOptions ? *handle_->targetOptions
+                                                          : TargetOptionsForModule(*GetModule());
+    std::unique_ptr<llvm::Module> copy = llvm::CloneModule(*GetModule());
+    std::vector<llvm::SmallVector<char, 0>> outputs;
+    if (llvm::Error err = EmitModuleSplit(*copy, options, fileType, threads, outputs)) {
+        Napi::Error::New(env, "Failed to emit code: " + llvm::toString(std::move(err)))
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (threads <= 1) {
+        return Napi::Buffer<char>::Copy(env, outputs[0].data(), outputs[0].size());
+    }
+    Napi::Array parts = Napi::Array::New(env, outputs.size());
+    for (size_t i = 0; i < outputs.size(); i++) {
+        parts.Set(static_cast<uint32_t>(i), Napi::Buffer<char>::Copy(env, outputs[i].data(), outputs[i].size()));
+    }
+    return parts;
+}
+
+// Reads { [function]: { entryCount, branches: [[count, ...], ...] } } as
+// returned by engine.getProfile(). Throws and returns false on invalid input.
+static bool ParseModuleProfile(Napi::Env env, const Napi::Object& object, ModuleProfile& profile) {
+    Napi::Array names = object.GetPropertyNames();
+    for (uint32_t i = 0; i < names.Length(); i++) {
+        std::string name = names.Get(i).ToString().Utf8Value();
+        Napi::Value entry = object.Get(name);
+        if (!entry.IsObject() || !entry.As<Napi::Object>().Get("entryCount").IsNumber() ||
+            !entry.As<Napi::Object>().Get("branches").IsArray()) {
+            Napi::TypeError::New(env, "Profile of " + name + " must be { entryCount, branches }")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+
+        FunctionProfile& counts = profile[name];
+        counts.entryCount = entry.As<Napi::Object>().Get("entryCount").As<Napi::Number>().Int64Value();
+        Napi::Array branches = entry.As<Napi::Object>().Get("branches").As<Napi::Array>();
+        for (uint32_t j = 0; j < branches.Length(); j++) {
+            Napi::Value edges = branches.Get(j);
+            if (!edges.IsArray() || edges.As<Napi::Array>().Length() == 0) {
+                Napi::TypeError::New(env, "Branch counts of " + name + " must be non-empty arrays")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+            std::vector<uint64_t> edgeCounts;
+            for (uint32_t k = 0; k < edges.As<Napi::Array>().Length(); k++) {
+                Napi::Value count = edges.As<Napi::Array>().Get(k);
+                if (!count.IsNumber() || count.As<Napi::Number>().DoubleValue() < 0) {
+                    Napi::TypeError::New(env, "Branch counts of " + name + " must be non-negative numbers")
+                        .ThrowAsJavaScriptException();
+                    return false;
+                }
+                edgeCounts.push_back(count.As<Napi::Number>().Int64Value());
+            }
+            counts.branches.push_back(std::move(edgeCounts));
+        }
+    }
+    return true;
+}
+
+// applyProfile(engine.getProfile()) on a fresh, uninstrumented build of
+// the same IR; optimize() then uses the counts
+Napi::Value ModuleWrapper::ApplyProfile(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Profile object expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ModuleProfile profile;
+    if (!ParseModuleProfile(env, info[0].As<Napi::Object>(), profile)) {
+        return env.Undefined();
+    }
+
+    if (llvm::Error err = llvm_nodejs::ApplyProfile(*GetModule(), profile)) {
+        Napi::Error::New(env, llvm::toString(std::move(err))).ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+Napi::Value ModuleWrapper::VerifyAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    VerifyJob* job = new VerifyJob(env, info.This().As<Napi::Object>(), module_.getContext(), GetModule());
+    Napi::Promise promise = job->GetPromise();
+    job->Queue();
+    return promise;
+}
+
+Napi::Value ModuleWrapper::OptimizeAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    OptimizationOptions options;
+    if (!ParseOptimizationOptions(env, info, options)) {
+        return env.Undefined();
+    }
+    OptimizeJob* job = new OptimizeJob(env, info.This().As<Napi::Object>(), module_.getContext(),
+                                       GetModule(), options, handle_->targetOptions);
+    Napi::Promise promise = job->GetPromise();
+    job->Queue();
+    return promise;
+}
+
+Napi::Value ModuleWrapper::CompileAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    if (info.Length() < 1 || !info[0].IsObject() ||
+        !JITEngineWrapper::IsInstance(info[0].As<Napi::Object>())) {
+        Napi::TypeError::New(env, "JITEngine argument expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    JITEngineWrapper* engineWrapper = Napi::ObjectWrap<JITEngineWrapper>::Unwrap(info[0].As<Napi::Object>());
+
+    CompileJob* job = new CompileJob(env, info.This().As<Napi::Object>(), engineWrapper->GetEngine(),
+                                     TakeModule());
+    Napi::Promise promise = job->GetPromise();
+    job->Queue();
+    return promise;
+}
+
+Napi::Value ModuleWrapper::EmitObjectAsync(const Napi::CallbackInfo& info) {
+    return EmitAsync(info, llvm::CGFT_ObjectFile);
+}
+
+Napi::Value ModuleWrapper::EmitAssemblyAsync(const Napi::CallbackInfo& info) {
+    return EmitAsync(info, llvm::CGFT_AssemblyFile);
+}
+
+Napi::Value ModuleWrapper::EmitAsync(const Napi::CallbackInfo& info, llvm::CodeGenFileType fileType) {
+    Napi::Env env = info.Env();
+    if (!CheckModule(env)) {
+        return env.Undefined();
+    }
+
+    unsigned threads;
+    if (!ParseEmitOptions(env, info, threads)) {
+        return env.Undefined();
+    }
+    EmitObjectJob* job = new EmitObjectJob(env, info.This().As<Napi::Object>(), module_.getContext(),
+                                           GetModule(), handle_->targetOptions, fileType, threads);
+    Napi::Promise promise = job->GetPromise();
+    job->Queue();
+    return promise;
+}
+
 }  // namespace llvm_nodejs
@@ -3,35 +3,114 @@
 #include <napi.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <memory>
+#include <string>
 
 namespace llvm_nodejs {
 
+struct TargetMachineOptions;
+
+// State shared by a module and the JS wrappers of its IR (functions, blocks,
+// instructions, ...). The wrappers hold raw pointers into the module, so
+// they check the handle before touching them.
+struct ModuleHandle {
+    // The module went to a JIT engine, which frees the IR after compiling it
+    bool taken = false;
+    // The ModuleWrapper was garbage collected and the module with it
+    bool destroyed = false;
+    // Set by setTarget(); optimization and code generation of the module and
+    // its functions use it instead of the default target machine for the
+    // module's triple
+    std::shared_ptr<const TargetMachineOptions> targetOptions;
+
+    bool IsReleased() const { return taken || destroyed; }
+};
+
+// Handle of the ModuleWrapper that owns `module`, or null for IR that no
+// wrapper owns, e.g. constants or instructions not inserted anywhere
+std::shared_ptr<ModuleHandle> GetModuleHandle(const llvm::Value* value);
+
+// Throws and returns false once the module behind `handle` has been
+// released
+bool CheckModuleHandle(Napi::Env env, const std::shared_ptr<ModuleHandle>& handle);
+
+// CheckModuleHandle, then (when `modify` is set) that no async job holds the
+// context of `value`. `value` is only touched if the handle is live.
+bool CheckModuleIR(Napi::Env env, const std::shared_ptr<ModuleHandle>& handle, const llvm::Value* value,
+                   bool modify);
+
+// Throws an Error for a pipeline that did not parse, with `code` set to
+// 'ERR_LLVM_PASS_PIPELINE' and the `pipeline` and parser `reason` attached
+void ThrowPassPipelineError(Napi::Env env, const std::string& pipeline, llvm::Error err);
+
 class ModuleWrapper : public Napi::ObjectWrap<ModuleWrapper> {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     ModuleWrapper(const Napi::CallbackInfo& info);
+    ~ModuleWrapper();
     
     // Static method to create a new ModuleWrapper from an existing module
-    static Napi::Object Create(Napi::Env env, std::unique_ptr<llvm::Module> module);
+    static Napi::Object Create(Napi::Env env, llvm::orc::ThreadSafeModule module);
+    static bool IsInstance(const Napi::Object& obj) {
+        return obj.InstanceOf(constructor.Value());
+    }
     
-    // Getter for the internal module
-    llvm::Module* GetModule() const { return module_.get(); }
+    // Getter for the internal module, null once the module has been taken
+    llvm::Module* GetModule() { return module_.getModuleUnlocked(); }
+
+    // Hands the module (and a reference to its context) over to the caller,
+    // e.g. a JITEngine. The wrapper and the wrappers of its IR are unusable
+    // afterwards.
+    llvm::orc::ThreadSafeModule TakeModule();
+    // Gives a module taken by TakeModule() back when the engine turned it
+    // down, making the wrappers of its IR usable again
+    void ReturnModule(llvm::orc::ThreadSafeModule module);
 
     // Module methods to expose to JavaScript
     Napi::Value GetModuleName(const Napi::CallbackInfo& info);
     Napi::Value SetModuleName(const Napi::CallbackInfo& info);
     Napi::Value Dump(const Napi::CallbackInfo& info);
+    Napi::Value PrintTo(const Napi::CallbackInfo& info);
+    Napi::Value ToBitcode(const Napi::CallbackInfo& info);
     Napi::Value SetTargetTriple(const Napi::CallbackInfo& info);
     Napi::Value SetDataLayout(const Napi::CallbackInfo& info);
+    Napi::Value SetTarget(const Napi::CallbackInfo& info);
     Napi::Value CreateFunction(const Napi::CallbackInfo& info);
     Napi::Value Verify(const Napi::CallbackInfo& info);
+    Napi::Value Optimize(const Napi::CallbackInfo& info);
+    Napi::Value RunPasses(const Napi::CallbackInfo& info);
+    Napi::Value ApplyProfile(const Napi::CallbackInfo& info);
+    Napi::Value Link(const Napi::CallbackInfo& info);
+    Napi::Value EmitObject(const Napi::CallbackInfo& info);
+    Napi::Value EmitAssembly(const Napi::CallbackInfo& info);
+
+    // Promise-returning variants that run on the libuv thread pool. The
+    // module's context is locked until the Promise settles.
+    Napi::Value VerifyAsync(const Napi::CallbackInfo& info);
+    Napi::Value OptimizeAsync(const Napi::CallbackInfo& info);
+    Napi::Value CompileAsync(const Napi::CallbackInfo& info);
+    Napi::Value EmitObjectAsync(const Napi::CallbackInfo& info);
+    Napi::Value EmitAssemblyAsync(const Napi::CallbackInfo& info);
 
 private:
-    std::unique_ptr<llvm::Module> module_;
+    // Throws and returns false if the module was already taken or its
+    // context is locked by an async job
+    bool CheckModule(Napi::Env env);
+
+    // Shared by the emit methods: lowers a copy of the module to an object
+    // file or assembly, split across the requested number of threads
+    Napi::Value Emit(const Napi::CallbackInfo& info, llvm::CodeGenFileType fileType);
+    Napi::Value EmitAsync(const Napi::CallbackInfo& info, llvm::CodeGenFileType fileType);
+
+    // Marks the handle released and forgets which module it belonged to
+    void ReleaseHandle();
+
+    llvm::orc::ThreadSafeModule module_;
+    std::shared_ptr<ModuleHandle> handle_;
     
     // Static persistent constructor
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
 };
 
-}  // namespace llvm_nodejs 
\ No newline at end of file
+}  // namespace llvm_nodejs
@@ -0,0 +1,102 @@
+#include "llvm_passes.h"
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <utility>
+
+namespace llvm_nodejs {
+
+llvm::OptimizationLevel OptimizationLevelFromNumber(unsigned level) {
+    switch (level) {
+    case 0: return llvm::OptimizationLevel::O0;
+    case 1: return llvm::OptimizationLevel::O1;
+    case 2: return llvm::OptimizationLevel::O2;
+    default: return llvm::OptimizationLevel::O3;
+    }
+}
+
+bool OptimizationLevelFromName(const std::string& name, llvm::OptimizationLevel& level) {
+    static const std::pair<const char*, llvm::OptimizationLevel> levels[] = {
+        {"O0", llvm::OptimizationLevel::O0}, {"O1", llvm::OptimizationLevel::O1},
+        {"O2", llvm::OptimizationLevel::O2}, {"O3", llvm::OptimizationLevel::O3},
+        {"Os", llvm::OptimizationLevel::Os}, {"Oz", llvm::OptimizationLevel::Oz},
+    };
+    for (const auto& entry : levels) {
+        if (name == entry.first) {
+            level = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The four analysis managers of the new pass manager, registered with a
+// PassBuilder and wired to each other through their proxies
+struct AnalysisManagers {
+    explicit AnalysisManagers(llvm::PassBuilder& passBuilder) {
+        passBuilder.registerModuleAnalyses(moduleAnalysisManager);
+        passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+        passBuilder.registerFunctionAnalyses(functionAnalysisManager);
+        passBuilder.registerLoopAnalyses(loopAnalysisManager);
+        passBuilder.crossRegisterProxies(loopAnalysisManager, functionAnalysisManager,
+                                         cgsccAnalysisManager, moduleAnalysisManager);
+    }
+
+    llvm::LoopAnalysisManager loopAnalysisManager;
+    llvm::FunctionAnalysisManager functionAnalysisManager;
+    llvm::CGSCCAnalysisManager cgsccAnalysisManager;
+    llvm::ModuleAnalysisManager moduleAnalysisManager;
+};
+
+void OptimizeModule(llvm::Module& module, const OptimizationOptions& options,
+                    llvm::TargetMachine* targetMachine) {
+    bool vectorize = options.vectorize && options.level.getSpeedupLevel() > 1 &&
+        options.level != llvm::OptimizationLevel::Oz;
+    llvm::PipelineTuningOptions tuningOptions;
+    tuningOptions.LoopVectorization = vectorize;
+    tuningOptions.SLPVectorization = vectorize;
+    tuningOptions.LoopUnrolling = options.unroll;
+    tuningOptions.LoopInterleaving = options.unroll;
+
+    llvm::PassBuilder passBuilder(targetMachine, tuningOptions);
+    AnalysisManagers analysisManagers(passBuilder);
+
+    llvm::ModulePassManager modulePassManager =
+        options.level == llvm::OptimizationLevel::O0
+            ? passBuilder.buildO0DefaultPipeline(options.level)
+            : passBuilder.buildPerModuleDefaultPipeline(options.level);
+    modulePassManager.run(module, analysisManagers.moduleAnalysisManager);
+}
+
+llvm::Error RunPassPipeline(llvm::Module& module, const std::string& pipeline,
+                            llvm::TargetMachine* targetMachine) {
+    llvm::PassBuilder passBuilder(targetMachine);
+    AnalysisManagers analysisManagers(passBuilder);
+
+    llvm::ModulePassManager modulePassManager;
+    if (llvm::Error err = passBuilder.parsePassPipeline(modulePassManager, pipeline)) {
+        return err;
+    }
+    modulePassManager.run(module, analysisManagers.moduleAnalysisManager);
+    return llvm::Error::success();
+}
+
+llvm::Error RunFunctionPassPipeline(llvm::Function& function, const std::string& pipeline,
+                                    llvm::TargetMachine* targetMachine) {
+    llvm::PassBuilder passBuilder(targetMachine);
+    AnalysisManagers analysisManagers(passBuilder);
+
+    llvm::FunctionPassManager functionPassManager;
+    if (llvm::Error err = passBuilder.parsePassPipeline(functionPassManager, pipeline)) {
+        return err;
+    }
+    // Function passes may look at module analyses, which have to be cached
+    // before the function pipeline runs on its own
+    analysisManagers.moduleAnalysisManager.getResult<llvm::ProfileSummaryAnalysis>(*function.getParent());
+    functionPassManager.run(function, analysisManagers.functionAnalysisManager);
+    return llvm::Error::success();
+}
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Target/TargetMachine.h>
+#include <string>
+
+namespace llvm_nodejs {
+
+struct OptimizationOptions {
+    llvm::OptimizationLevel level = llvm::OptimizationLevel::O2;
+    // Loop and SLP vectorization, applied at O2 and above except Oz (as
+    // clang does)
+    bool vectorize = true;
+    // Loop unrolling and interleaving
+    bool unroll = true;
+};
+
+// Maps 0-3 onto O0-O3
+llvm::OptimizationLevel OptimizationLevelFromNumber(unsigned level);
+
+// Parses "O0", "O1", "O2", "O3", "Os" or "Oz"; returns false for anything else
+bool OptimizationLevelFromName(const std::string& name, llvm::OptimizationLevel& level);
+
+// Runs the standard new-pass-manager pipeline on the module. With a target
+// machine the passes get target specific cost models (TTI).
+void OptimizeModule(llvm::Module& module, const OptimizationOptions& options,
+                    llvm::TargetMachine* targetMachine = nullptr);
+
+// Parses a pipeline in the textual syntax of `opt -passes=`, such as
+// "function(mem2reg,instcombine),globaldce", and runs it on the module.
+// Fails without touching the module if the pipeline does not parse.
+llvm::Error RunPassPipeline(llvm::Module& module, const std::string& pipeline,
+                            llvm::TargetMachine* targetMachine = nullptr);
+
+// Runs a function pipeline such as "instcombine,gvn" on one function; the
+// rest of the module is left alone
+llvm::Error RunFunctionPassPipeline(llvm::Function& function, const std::string& pipeline,
+                                    llvm::TargetMachine* targetMachine = nullptr);
+
+}  // namespace llvm_nodejs
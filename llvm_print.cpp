@@ -0,0 +1,90 @@
+#include "llvm_print.h"
+#include <algorithm>
+#include <string>
+
+namespace llvm_nodejs {
+
+static const size_t defaultChunkSize = 64 * 1024;
+
+ChunkedCallbackStream::ChunkedCallbackStream(Napi::Function callback, Napi::Value receiver, size_t chunkSize)
+    : callback_(callback), receiver_(receiver), chunkSize_(chunkSize), position_(0) {
+    // Full buffers are flushed as exactly one chunk
+    SetBufferSize(chunkSize_);
+}
+
+ChunkedCallbackStream::~ChunkedCallbackStream() {
+    flush();
+}
+
+void ChunkedCallbackStream::write_impl(const char* ptr, size_t size) {
+    position_ += size;
+    Napi::Env env = callback_.Env();
+    while (size > 0 && !env.IsExceptionPending()) {
+        // Release each chunk once the callback is done with it rather than
+        // when printing returns
+        Napi::HandleScope scope(env);
+        size_t length = std::min(size, chunkSize_);
+        callback_.Call(receiver_, { Napi::Buffer<char>::Copy(env, ptr, length) });
+        ptr += length;
+        size -= length;
+    }
+}
+
+bool PrintTo(const Napi::CallbackInfo& info, llvm::function_ref<void(llvm::raw_ostream&)> print) {
+    Napi::Env env = info.Env();
+
+    size_t chunkSize = defaultChunkSize;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Value chunkSizeValue = info[1].As<Napi::Object>().Get("chunkSize");
+        if (!chunkSizeValue.IsUndefined()) {
+            if (!chunkSizeValue.IsNumber() || chunkSizeValue.As<Napi::Number>().DoubleValue() < 1) {
+                Napi::RangeError::New(env, "chunkSize must be a positive number").ThrowAsJavaScriptException();
+                return false;
+            }
+            chunkSize = chunkSizeValue.As<Napi::Number>().Uint32Value();
+        }
+    }
+
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        int fd = info[0].As<Napi::Number>().Int32Value();
+        if (fd < 0) {
+            Napi::RangeError::New(env, "Invalid file descriptor").ThrowAsJavaScriptException();
+            return false;
+        }
+        // The descriptor stays open; it belongs to the caller
+        llvm::raw_fd_ostream stream(fd, false);
+        stream.SetBufferSize(chunkSize);
+        print(stream);
+        stream.flush();
+        if (stream.has_error()) {
+            std::string message = stream.error().message();
+            // raw_fd_ostream treats an unhandled error as fatal
+            stream.clear_error();
+            Napi::Error::New(env, "Failed to write IR: " + message).ThrowAsJavaScriptException();
+            return false;
+        }
+        return true;
+    }
+
+    Napi::Function callback;
+    Napi::Value receiver = env.Undefined();
+    if (info.Length() > 0 && info[0].IsFunction()) {
+        callback = info[0].As<Napi::Function>();
+    } else if (info.Length() > 0 && info[0].IsObject() &&
+               info[0].As<Napi::Object>().Get("write").IsFunction()) {
+        receiver = info[0];
+        callback = info[0].As<Napi::Object>().Get("write").As<Napi::Function>();
+    } else {
+        Napi::TypeError::New(env, "File descriptor, callback or Writable stream expected")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    {
+        ChunkedCallbackStream stream(callback, receiver, chunkSize);
+        print(stream);
+    }
+    return !env.IsExceptionPending();
+}
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <napi.h>
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace llvm_nodejs {
+
+// raw_ostream that hands its output to a JS function in Buffers of at most
+// `chunkSize` bytes instead of collecting it in memory. Once the function
+// throws, the rest of the output is dropped and the exception stays pending.
+class ChunkedCallbackStream : public llvm::raw_ostream {
+public:
+    ChunkedCallbackStream(Napi::Function callback, Napi::Value receiver, size_t chunkSize);
+    ~ChunkedCallbackStream() override;
+
+private:
+    void write_impl(const char* ptr, size_t size) override;
+    uint64_t current_pos() const override { return position_; }
+
+    Napi::Function callback_;
+    Napi::Value receiver_;
+    size_t chunkSize_;
+    uint64_t position_;
+};
+
+// printTo(fd | callback | writable, { chunkSize }) as shared by modules and
+// functions: streams what `print` writes to a file descriptor, or in chunks
+// to a callback or to the write() method of a Writable stream. Writes are
+// synchronous and do not wait for a stream to drain. Throws and returns
+// false on invalid input or write errors.
+bool PrintTo(const Napi::CallbackInfo& info, llvm::function_ref<void(llvm::raw_ostream&)> print);
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,160 @@
+#include "llvm_profile.h"
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/ProfileSummary.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/ProfileCommon.h>
+#include <algorithm>
+#include <limits>
+
+namespace llvm_nodejs {
+
+// Only conditional branches and switches get edge counters; other
+// terminators with several successors (invoke, indirectbr, callbr) are left
+// alone by both instrumentation and ApplyProfile
+static bool IsCountedBranch(const llvm::Instruction* terminator) {
+    if (const llvm::BranchInst* branch = llvm::dyn_cast_or_null<llvm::BranchInst>(terminator)) {
+        return branch->isConditional();
+    }
+    return llvm::isa_and_nonnull<llvm::SwitchInst>(terminator);
+}
+
+static std::vector<llvm::Instruction*> CountedBranches(llvm::Function& function) {
+    std::vector<llvm::Instruction*> branches;
+    for (llvm::BasicBlock& block : function) {
+        if (IsCountedBranch(block.getTerminator())) {
+            branches.push_back(block.getTerminator());
+        }
+    }
+    return branches;
+}
+
+static void IncrementCounter(llvm::IRBuilder<>& builder, llvm::GlobalVariable* counters, unsigned index) {
+    llvm::Type* int64Type = builder.getInt64Ty();
+    llvm::Value* slot = builder.CreateConstInBoundsGEP2_32(counters->getValueType(), counters, 0, index);
+    llvm::Value* count = builder.CreateLoad(int64Type, slot);
+    builder.CreateStore(builder.CreateAdd(count, builder.getInt64(1)), slot);
+}
+
+std::vector<ProfileLayout> InstrumentModule(llvm::Module& module, const std::string& counterPrefix) {
+    std::vector<ProfileLayout> layouts;
+    llvm::LLVMContext& context = module.getContext();
+
+    std::vector<llvm::Function*> functions;
+    for (llvm::Function& function : module) {
+        if (!function.isDeclaration()) {
+            functions.push_back(&function);
+        }
+    }
+
+    for (llvm::Function* function : functions) {
+        ProfileLayout layout;
+        layout.function = function->getName().str();
+        layout.counters = counterPrefix + layout.function;
+
+        std::vector<llvm::Instruction*> branches = CountedBranches(*function);
+        unsigned counterCount = 1;
+        for (llvm::Instruction* branch : branches) {
+            layout.branches.push_back(branch->getNumSuccessors());
+            counterCount += branch->getNumSuccessors();
+        }
+
+        llvm::ArrayType* arrayType = llvm::ArrayType::get(llvm::Type::getInt64Ty(context), counterCount);
+        llvm::GlobalVariable* counters = new llvm::GlobalVariable(
+            module, arrayType, false, llvm::GlobalValue::ExternalLinkage,
+            llvm::ConstantAggregateZero::get(arrayType), layout.counters);
+
+        llvm::IRBuilder<> builder(&*function->getEntryBlock().getFirstInsertionPt());
+        IncrementCounter(builder, counters, 0);
+
+        // Every edge gets a block of its own that bumps its counter, with
+        // the phis of the successor moved over to it
+        unsigned index = 1;
+        for (llvm::Instruction* branch : branches) {
+            llvm::BasicBlock* source = branch->getParent();
+            for (unsigned i = 0; i < branch->getNumSuccessors(); i++, index++) {
+                llvm::BasicBlock* target = branch->getSuccessor(i);
+                llvm::BasicBlock* edge = llvm::BasicBlock::Create(
+                    context, source->getName() + ".prof", function, target);
+                builder.SetInsertPoint(edge);
+                IncrementCounter(builder, counters, index);
+                builder.CreateBr(target);
+                branch->setSuccessor(i, edge);
+                for (llvm::PHINode& phi : target->phis()) {
+                    int incoming = phi.getBasicBlockIndex(source);
+                    if (incoming >= 0) {
+                        phi.setIncomingBlock(incoming, edge);
+                    }
+                }
+            }
+        }
+
+        layouts.push_back(std::move(layout));
+    }
+    return layouts;
+}
+
+FunctionProfile ReadProfileCounters(const ProfileLayout& layout, const uint64_t* counters) {
+    FunctionProfile profile;
+    profile.entryCount = counters[0];
+    size_t index = 1;
+    for (unsigned successors : layout.branches) {
+        profile.branches.emplace_back(counters + index, counters + index + successors);
+        index += successors;
+    }
+    return profile;
+}
+
+llvm::Error ApplyProfile(llvm::Module& module, const ModuleProfile& profile) {
+    // Check every function first so that a mismatch leaves the module as is
+    std::vector<std::pair<llvm::Function*, const FunctionProfile*>> matched;
+    for (const auto& entry : profile) {
+        llvm::Function* function = module.getFunction(entry.first);
+        if (!function || function->isDeclaration()) {
+            continue;
+        }
+        std::vector<llvm::Instruction*> branches = CountedBranches(*function);
+        bool matches = branches.size() == entry.second.branches.size();
+        for (size_t i = 0; matches && i < branches.size(); i++) {
+            matches = branches[i]->getNumSuccessors() == entry.second.branches[i].size();
+        }
+        if (!matches) {
+            return llvm::make_error<llvm::StringError>(
+                "Profile does not match the branches of function: " + entry.first, llvm::inconvertibleErrorCode());
+        }
+        matched.emplace_back(function, &entry.second);
+    }
+
+    llvm::InstrProfSummaryBuilder summaryBuilder(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+    llvm::MDBuilder metadata(module.getContext());
+    for (const auto& entry : matched) {
+        llvm::Function* function = entry.first;
+        const FunctionProfile& counts = *entry.second;
+        function->setEntryCount(llvm::Function::ProfileCount(counts.entryCount, llvm::Function::PCT_Real));
+
+        std::vector<uint64_t> record = {counts.entryCount};
+        std::vector<llvm::Instruction*> branches = CountedBranches(*function);
+        for (size_t i = 0; i < branches.size(); i++) {
+            // Branch weights are 32 bits wide; scale large counts down
+            uint64_t largest = *std::max_element(counts.branches[i].begin(), counts.branches[i].end());
+            uint64_t scale = largest / std::numeric_limits<uint32_t>::max() + 1;
+            std::vector<uint32_t> weights;
+            for (uint64_t count : counts.branches[i]) {
+                weights.push_back(static_cast<uint32_t>(count / scale));
+                record.push_back(count);
+            }
+            branches[i]->setMetadata(llvm::LLVMContext::MD_prof, metadata.createBranchWeights(weights));
+        }
+        summaryBuilder.addRecord(llvm::InstrProfRecord(std::move(record)));
+    }
+
+    if (!matched.empty()) {
+        std::unique_ptr<llvm::ProfileSummary> summary = summaryBuilder.getSummary();
+        module.setProfileSummary(summary->getMD(module.getContext()), llvm::ProfileSummary::PSK_Instr);
+    }
+    return llvm::Error::success();
+}
+
+}  // namespace llvm_nodejs
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm_nodejs {
+
+// Where the counters of an instrumented function live: a global array of
+// i64 holding the entry count followed by one count per edge of every
+// conditional branch and switch, in block order
+struct ProfileLayout {
+    std::string function;
+    std::string counters;
+    // Successor count of each counted branch
+    std::vector<unsigned> branches;
+};
+
+// Counts read back from an instrumented function; `branches[i][j]` is how
+// often the i-th counted branch went to its j-th successor
+struct FunctionProfile {
+    uint64_t entryCount = 0;
+    std::vector<std::vector<uint64_t>> branches;
+};
+
+using ModuleProfile = std::map<std::string, FunctionProfile>;
+
+// Adds an entry counter and edge counters to every function defined in the
+// module. The counter arrays are external globals named `counterPrefix` +
+// function name. The increments are not atomic, so counts from threads
+// running the same code at once are approximate.
+std::vector<ProfileLayout> InstrumentModule(llvm::Module& module, const std::string& counterPrefix);
+
+// Splits the flat counter array of `layout` into a FunctionProfile
+FunctionProfile ReadProfileCounters(const ProfileLayout& layout, const uint64_t* counters);
+
+// Attaches function entry counts, branch weights and a profile summary
+// for the functions in `profile`, so that the next optimization run lays
+// out blocks and inlines by the recorded traffic. The module must be built
+// the same way as the instrumented one; fails without changing anything if
+// a function's branches do not match its profile.
+llvm::Error ApplyProfile(llvm::Module& module, const ModuleProfile& profile);
+
+}  // namespace llvm_nodejs
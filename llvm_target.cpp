@@ -0,0 +1,154 @@
+#include "llvm_target.h"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetOptions.h>
+#include <algorithm>
+#include <mutex>
+
+namespace llvm_nodejs {
+
+static std::once_flag nativeTargetInitFlag;
+
+void InitializeNativeTargetOnce() {
+    std::call_once(nativeTargetInitFlag, []() {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
+}
+
+TargetMachineOptions DetectHostTargetOptions() {
+    TargetMachineOptions options;
+    options.triple = llvm::sys::getProcessTriple();
+    options.cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> hostFeatures;
+    if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+        llvm::SubtargetFeatures featureList;
+        for (const auto& feature : hostFeatures) {
+            featureList.AddFeature(feature.first(), feature.second);
+        }
+        options.features = featureList.getString();
+    }
+    return options;
+}
+
+llvm::Expected<std::unique_ptr<llvm::TargetMachine>> CreateTargetMachine(const TargetMachineOptions& options) {
+    InitializeNativeTargetOnce();
+
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(options.triple, error);
+    if (!target) {
+        return llvm::make_error<llvm::StringError>(error, llvm::inconvertibleErrorCode());
+    }
+
+    llvm::TargetOptions targetOptions;
+    std::unique_ptr<llvm::TargetMachine> targetMachine(target->createTargetMachine(
+        options.triple, options.cpu, options.features, targetOptions, options.relocModel, options.codeModel,
+        options.level));
+    if (!targetMachine) {
+        return llvm::make_error<llvm::StringError>("Failed to create target machine for " + options.triple,
+                                                   llvm::inconvertibleErrorCode());
+    }
+    return targetMachine;
+}
+
+TargetMachineOptions TargetOptionsForModule(const llvm::Module& module, llvm::CodeGenOpt::Level level) {
+    // Only tune for the CPU we run on when generating code for the host
+    TargetMachineOptions moduleOptions = DetectHostTargetOptions();
+    if (!module.getTargetTriple().empty() && module.getTargetTriple() != moduleOptions.triple) {
+        moduleOptions = TargetMachineOptions();
+        moduleOptions.triple = module.getTargetTriple();
+    }
+    moduleOptions.level = level;
+    return moduleOptions;
+}
+
+llvm::Expected<std::unique_ptr<llvm::TargetMachine>> CreateTargetMachineForModule(
+    const llvm::Module& module, llvm::CodeGenOpt::Level level) {
+    return CreateTargetMachine(TargetOptionsForModule(module, level));
+}
+
+void SetFunctionTarget(llvm::Function& function, const TargetMachineOptions& options) {
+    if (options.cpu.empty()) {
+        function.removeFnAttr("target-cpu");
+    } else {
+        function.addFnAttr("target-cpu", options.cpu);
+    }
+    if (options.features.empty()) {
+        function.removeFnAttr("target-features");
+    } else {
+        function.addFnAttr("target-features", options.features);
+    }
+}
+
+llvm::Error EmitModule(llvm::Module& module, llvm::TargetMachine& targetMachine,
+                       llvm::CodeGenFileType fileType, llvm::SmallVectorImpl<char>& output) {
+    if (module.getTargetTriple().empty()) {
+        module.setTargetTriple(targetMachine.getTargetTriple().str());
+    }
+    if (module.getDataLayout().isDefault()) {
+        module.setDataLayout(targetMachine.createDataLayout());
+    }
+
+    llvm::raw_svector_ostream stream(output);
+    llvm::legacy::PassManager passManager;
+    if (targetMachine.addPassesToEmitFile(passManager, stream, nullptr, fileType)) {
+        return llvm::make_error<llvm::StringError>("Target cannot emit this file type",
+                                                   llvm::inconvertibleErrorCode());
+    }
+    passManager.run(module);
+    return llvm::Error::success();
+}
+
+llvm::Error EmitModuleSplit(llvm::Module& module, const TargetMachineOptions& options,
+                            llvm::CodeGenFileType fileType, unsigned partitions,
+                            std::vector<llvm::SmallVector<char, 0>>& outputs) {
+    auto targetMachine = CreateTargetMachine(options);
+    if (!targetMachine) {
+        return targetMachine.takeError();
+    }
+
+    partitions = std::max(partitions, 1u);
+    outputs.assign(partitions, llvm::SmallVector<char, 0>());
+    if (partitions == 1) {
+        return EmitModule(module, **targetMachine, fileType, outputs[0]);
+    }
+
+    if (module.getTargetTriple().empty()) {
+        module.setTargetTriple((*targetMachine)->getTargetTriple().str());
+    }
+    if (module.getDataLayout().isDefault()) {
+        module.setDataLayout((*targetMachine)->createDataLayout());
+    }
+
+    // splitCodeGen treats a target that cannot emit the file type as fatal,
+    // so check up front
+    llvm::SmallVector<char, 0> scratch;
+    llvm::raw_svector_ostream scratchStream(scratch);
+    llvm::legacy::PassManager probe;
+    if ((*targetMachine)->addPassesToEmitFile(probe, scratchStream, nullptr, fileType)) {
+        return llvm::make_error<llvm::StringError>("Target cannot emit this file type",
+                                                   llvm::inconvertibleErrorCode());
+    }
+
+    std::vector<std::unique_ptr<llvm::raw_svector_ostream>> streams;
+    std::vector<llvm::raw_pwrite_stream*> streamPointers;
+    for (llvm::SmallVector<char, 0>& output : outputs) {
+        streams.push_back(std::make_unique<llvm::raw_svector_ostream>(output));
+        streamPointers.push_back(streams.back().get());
+    }
+
+    // Every code generation thread gets a target machine of its own
+    llvm::splitCodeGen(module, streamPointers, {}, [&options]() {
+        return llvm::cantFail(CreateTargetMachine(options));
+    }, fileType);
+    return llvm::Error::success();
+}
+
+}  // namespace llvm_nodejs
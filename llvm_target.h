@@ -0,0 +1,62 @@
+#pragma once
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm_nodejs {
+
+// Registers the host target with LLVM. Safe to call any number of times from
+// any thread.
+void InitializeNativeTargetOnce();
+
+// Everything that selects a target machine. Empty `cpu` and `features` mean
+// the generic CPU of the triple.
+struct TargetMachineOptions {
+    std::string triple;
+    std::string cpu;
+    std::string features;
+    llvm::Reloc::Model relocModel = llvm::Reloc::PIC_;
+    llvm::Optional<llvm::CodeModel::Model> codeModel;
+    llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default;
+};
+
+// Options for code that runs on this machine: the process triple and the
+// name and features of the host CPU
+TargetMachineOptions DetectHostTargetOptions();
+
+llvm::Expected<std::unique_ptr<llvm::TargetMachine>> CreateTargetMachine(const TargetMachineOptions& options);
+
+// Sets the "target-cpu" and "target-features" attributes the code generator
+// reads per function. Empty values remove them.
+void SetFunctionTarget(llvm::Function& function, const TargetMachineOptions& options);
+
+// Options for the module's triple, or for the host (including its CPU
+// features) when the module has none
+TargetMachineOptions TargetOptionsForModule(const llvm::Module& module,
+                                            llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default);
+
+llvm::Expected<std::unique_ptr<llvm::TargetMachine>> CreateTargetMachineForModule(
+    const llvm::Module& module, llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default);
+
+// Runs the code generator over the module and appends the object file or
+// assembly to `output`. Code generation lowers the IR in place, so callers
+// pass a copy when they still need the module.
+llvm::Error EmitModule(llvm::Module& module, llvm::TargetMachine& targetMachine,
+                       llvm::CodeGenFileType fileType, llvm::SmallVectorImpl<char>& output);
+
+// Splits the module into `partitions` parts and generates code for them on
+// as many threads (llvm::splitCodeGen), producing one object file or
+// assembly listing per part. Linked together the objects are equivalent to
+// the output of EmitModule. The module is split in place, so callers pass
+// a copy when they still need it.
+llvm::Error EmitModuleSplit(llvm::Module& module, const TargetMachineOptions& options,
+                            llvm::CodeGenFileType fileType, unsigned partitions,
+                            std::vector<llvm::SmallVector<char, 0>>& outputs);
+
+}  // namespace llvm_nodejs
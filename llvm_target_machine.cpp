@@ -0,0 +1,168 @@
+#include "llvm_target_machine.h"
+#include <llvm/IR/DataLayout.h>
+#include <llvm/Support/Host.h>
+
+namespace llvm_nodejs {
+
+thread_local Napi::FunctionReference TargetMachineWrapper::constructor;
+
+static bool RelocModelFromName(const std::string& name, llvm::Reloc::Model& model) {
+    static const std::pair<const char*, llvm::Reloc::Model> models[] = {
+        {"static", llvm::Reloc::Static}, {"pic", llvm::Reloc::PIC_},
+        {"dynamic-no-pic", llvm::Reloc::DynamicNoPIC}, {"ropi", llvm::Reloc::ROPI},
+        {"rwpi", llvm::Reloc::RWPI}, {"ropi-rwpi", llvm::Reloc::ROPI_RWPI},
+    };
+    for (const auto& entry : models) {
+        if (name == entry.first) {
+            model = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool CodeModelFromName(const std::string& name, llvm::CodeModel::Model& model) {
+    static const std::pair<const char*, llvm::CodeModel::Model> models[] = {
+        {"tiny", llvm::CodeModel::Tiny}, {"small", llvm::CodeModel::Small},
+        {"kernel", llvm::CodeModel::Kernel}, {"medium", llvm::CodeModel::Medium},
+        {"large", llvm::CodeModel::Large},
+    };
+    for (const auto& entry : models) {
+        if (name == entry.first) {
+            model = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Applies { triple, cpu, features, relocModel, codeModel, optLevel } on top
+// of `options`. A different triple drops the CPU and features it replaces
+// unless they are given as well. Throws and returns false on invalid input.
+static bool ApplyTargetOverrides(Napi::Env env, const Napi::Object& overrides, TargetMachineOptions& options) {
+    Napi::Value triple = overrides.Get("triple");
+    if (triple.IsString()) {
+        std::string value = triple.As<Napi::String>().Utf8Value();
+        if (value != options.triple) {
+            options.triple = value;
+            options.cpu.clear();
+            options.features.clear();
+        }
+    }
+    Napi::Value cpu = overrides.Get("cpu");
+    if (cpu.IsString()) {
+        options.cpu = cpu.As<Napi::String>().Utf8Value();
+    }
+    Napi::Value features = overrides.Get("features");
+    if (features.IsString()) {
+        options.features = features.As<Napi::String>().Utf8Value();
+    }
+
+    Napi::Value relocModel = overrides.Get("relocModel");
+    if (relocModel.IsString() &&
+        !RelocModelFromName(relocModel.As<Napi::String>().Utf8Value(), options.relocModel)) {
+        Napi::RangeError::New(env, "relocModel must be one of static, pic, dynamic-no-pic, ropi, rwpi, ropi-rwpi")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Value codeModel = overrides.Get("codeModel");
+    if (codeModel.IsString()) {
+        llvm::CodeModel::Model model;
+        if (!CodeModelFromName(codeModel.As<Napi::String>().Utf8Value(), model)) {
+            Napi::RangeError::New(env, "codeModel must be one of tiny, small, kernel, medium, large")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        options.codeModel = model;
+    }
+
+    Napi::Value optLevel = overrides.Get("optLevel");
+    if (optLevel.IsNumber()) {
+        switch (optLevel.As<Napi::Number>().Uint32Value()) {
+        case 0: options.level = llvm::CodeGenOpt::None; break;
+        case 1: options.level = llvm::CodeGenOpt::Less; break;
+        case 2: options.level = llvm::CodeGenOpt::Default; break;
+        case 3: options.level = llvm::CodeGenOpt::Aggressive; break;
+        default:
+            Napi::RangeError::New(env, "optLevel must be 0-3").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    return true;
+}
+
+// new TargetMachine(options) starts from the generic CPU of the process
+// triple; TargetMachine.detectHost(options) starts from the host CPU and its
+// features
+TargetMachineWrapper::TargetMachineWrapper(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<TargetMachineWrapper>(info) {
+    Napi::Env env = info.Env();
+
+    TargetMachineOptions options;
+    size_t overridesIndex = 0;
+    if (info.Length() > 0 && info[0].IsExternal()) {
+        std::unique_ptr<TargetMachineOptions> base(info[0].As<Napi::External<TargetMachineOptions>>().Data());
+        options = *base;
+        overridesIndex = 1;
+    } else {
+        options.triple = llvm::sys::getProcessTriple();
+    }
+
+    if (info.Length() > overridesIndex && info[overridesIndex].IsObject() &&
+        !ApplyTargetOverrides(env, info[overridesIndex].As<Napi::Object>(), options)) {
+        return;
+    }
+
+    auto targetMachine = CreateTargetMachine(options);
+    if (!targetMachine) {
+        Napi::Error::New(env, "Failed to create target machine: " + llvm::toString(targetMachine.takeError()))
+            .ThrowAsJavaScriptException();
+        return;
+    }
+    targetMachine_ = std::move(*targetMachine);
+    options_ = std::make_shared<const TargetMachineOptions>(std::move(options));
+}
+
+Napi::Object TargetMachineWrapper::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "TargetMachine", {
+        StaticMethod("detectHost", &TargetMachineWrapper::DetectHost),
+        InstanceMethod("getTriple", &TargetMachineWrapper::GetTriple),
+        InstanceMethod("getCPU", &TargetMachineWrapper::GetCPU),
+        InstanceMethod("getFeatures", &TargetMachineWrapper::GetFeatures),
+        InstanceMethod("getDataLayout", &TargetMachineWrapper::GetDataLayout)
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("TargetMachine", func);
+    return exports;
+}
+
+Napi::Value TargetMachineWrapper::DetectHost(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::External<TargetMachineOptions> external = Napi::External<TargetMachineOptions>::New(
+        env, new TargetMachineOptions(DetectHostTargetOptions()));
+    if (info.Length() > 0 && info[0].IsObject()) {
+        return constructor.New({ external, info[0] });
+    }
+    return constructor.New({ external });
+}
+
+Napi::Value TargetMachineWrapper::GetTriple(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), options_->triple);
+}
+
+Napi::Value TargetMachineWrapper::GetCPU(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), targetMachine_->getTargetCPU().str());
+}
+
+Napi::Value TargetMachineWrapper::GetFeatures(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), targetMachine_->getTargetFeatureString().str());
+}
+
+Napi::Value TargetMachineWrapper::GetDataLayout(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), targetMachine_->createDataLayout().getStringRepresentation());
+}
+
+}  // namespace llvm_nodejs
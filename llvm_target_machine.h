@@ -0,0 +1,36 @@
+#pragma once
+
+#include <napi.h>
+#include <llvm/Target/TargetMachine.h>
+#include "llvm_target.h"
+#include <memory>
+
+namespace llvm_nodejs {
+
+// JS handle of a target configuration: triple, CPU, features, relocation
+// and code model. module.setTarget(tm) applies it to a module.
+class TargetMachineWrapper : public Napi::ObjectWrap<TargetMachineWrapper> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    TargetMachineWrapper(const Napi::CallbackInfo& info);
+    static bool IsInstance(const Napi::Object& obj) {
+        return obj.InstanceOf(constructor.Value());
+    }
+
+    std::shared_ptr<const TargetMachineOptions> GetOptions() const { return options_; }
+    llvm::TargetMachine* GetTargetMachine() const { return targetMachine_.get(); }
+
+private:
+    static thread_local Napi::FunctionReference constructor;
+
+    static Napi::Value DetectHost(const Napi::CallbackInfo& info);
+    Napi::Value GetTriple(const Napi::CallbackInfo& info);
+    Napi::Value GetCPU(const Napi::CallbackInfo& info);
+    Napi::Value GetFeatures(const Napi::CallbackInfo& info);
+    Napi::Value GetDataLayout(const Napi::CallbackInfo& info);
+
+    std::shared_ptr<const TargetMachineOptions> options_;
+    std::unique_ptr<llvm::TargetMachine> targetMachine_;
+};
+
+}  // namespace llvm_nodejs
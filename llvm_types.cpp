@@ -1,5 +1,6 @@
 #include "llvm_types.h"
 #include "llvm_context.h"
+#include "llvm_async.h"
 #include <llvm/IR/Type.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
@@ -8,11 +9,11 @@
 namespace llvm_nodejs {
 
 // Initialize static constructor references
-Napi::FunctionReference TypeWrapper::constructor;
-Napi::FunctionReference StructTypeWrapper::constructor;
-Napi::FunctionReference ArrayTypeWrapper::constructor;
-Napi::FunctionReference PointerTypeWrapper::constructor;
-Napi::FunctionReference FunctionTypeWrapper::constructor;
+thread_local Napi::FunctionReference TypeWrapper::constructor;
+thread_local Napi::FunctionReference StructTypeWrapper::constructor;
+thread_local Napi::FunctionReference ArrayTypeWrapper::constructor;
+thread_local Napi::FunctionReference PointerTypeWrapper::constructor;
+thread_local Napi::FunctionReference FunctionTypeWrapper::constructor;
 
 //
 // Base TypeWrapper implementation
@@ -138,6 +139,9 @@ Napi::Value StructTypeWrapper::Create(const Napi::CallbackInfo& info) {
     
     LLVMContextWrapper* contextWrapper = 
         Napi::ObjectWrap<LLVMContextWrapper>::Unwrap(info[0].As<Napi::Object>());
+    if (!CheckContextUnlocked(env, contextWrapper->GetContext())) {
+        return env.Null();
+    }
     std::string name = info[1].As<Napi::String>().Utf8Value();
     
     llvm::StructType* structType = llvm::StructType::create(
@@ -170,6 +174,9 @@ Napi::Value StructTypeWrapper::SetBody(const Napi::CallbackInfo& info) {
         types.push_back(typeWrapper->GetType());
     }
     
+    if (!CheckContextUnlocked(env, structType_->getContext())) {
+        return env.Undefined();
+    }
     structType_->setBody(types);
     return env.Undefined();
 }
@@ -241,6 +248,9 @@ Napi::Value ArrayTypeWrapper::Get(const Napi::CallbackInfo& info) {
     
     TypeWrapper* elementTypeWrapper = Napi::ObjectWrap<TypeWrapper>::Unwrap(info[0].As<Napi::Object>());
     uint32_t numElements = info[1].As<Napi::Number>().Uint32Value();
+    if (!CheckContextUnlocked(env, elementTypeWrapper->GetType()->getContext())) {
+        return env.Null();
+    }
     
     llvm::ArrayType* arrayType = llvm::ArrayType::get(
         elementTypeWrapper->GetType(), numElements);
@@ -307,6 +317,9 @@ Napi::Value PointerTypeWrapper::Get(const Napi::CallbackInfo& info) {
     
     TypeWrapper* elementTypeWrapper = Napi::ObjectWrap<TypeWrapper>::Unwrap(info[0].As<Napi::Object>());
     unsigned addressSpace = info[1].As<Napi::Number>().Uint32Value();
+    if (!CheckContextUnlocked(env, elementTypeWrapper->GetType()->getContext())) {
+        return env.Null();
+    }
     
     llvm::PointerType* pointerType = llvm::PointerType::get(
         elementTypeWrapper->GetType(), addressSpace);
@@ -395,6 +408,10 @@ Napi::Value FunctionTypeWrapper::Get(const Napi::CallbackInfo& info) {
         isVarArg = info[2].As<Napi::Boolean>().Value();
     }
     
+    if (!CheckContextUnlocked(env, returnTypeWrapper->GetType()->getContext())) {
+        return env.Null();
+    }
+    
     llvm::FunctionType* functionType = llvm::FunctionType::get(
         returnTypeWrapper->GetType(), paramTypes, isVarArg);
     
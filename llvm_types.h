@@ -19,7 +19,7 @@ public:
     }
 
 private:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     llvm::Type* type_;
     
     Napi::Value IsIntegerTy(const Napi::CallbackInfo& info);
@@ -45,7 +45,7 @@ public:
     llvm::StructType* GetStructType() const { return structType_; }
 
 private:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     llvm::StructType* structType_;
     
     Napi::Value SetBody(const Napi::CallbackInfo& info);
@@ -65,7 +65,7 @@ public:
     llvm::ArrayType* GetArrayType() const { return arrayType_; }
 
 private:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     llvm::ArrayType* arrayType_;
     
     Napi::Value GetElementType(const Napi::CallbackInfo& info);
@@ -83,7 +83,7 @@ public:
     llvm::PointerType* GetPointerType() const { return pointerType_; }
 
 private:
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     llvm::PointerType* pointerType_;
     
     Napi::Value GetElementType(const Napi::CallbackInfo& info);
@@ -95,7 +95,7 @@ class FunctionTypeWrapper : public Napi::ObjectWrap<FunctionTypeWrapper> {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     static Napi::Object CreateWrapper(Napi::Env env, llvm::FunctionType* functionType);
-    static Napi::FunctionReference constructor;
+    static thread_local Napi::FunctionReference constructor;
     
     FunctionTypeWrapper(const Napi::CallbackInfo& info);
     llvm::FunctionType* GetFunctionType() { return functionType_; }
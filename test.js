@@ -268,3 +268,644 @@ console.log(module.dump());
 
 
 
+// ==================== JIT Demo ====================
+console.log('\n========== JIT Demo ==========');
+
+// Hand the module over to the JIT; it can no longer be modified afterwards
+const jit = new llvm.JITEngine();
+jit.addModule(module);
+
+// Signatures are taken from the module, so only the name is needed
+const addNumbers = jit.getFunction('add_numbers');
+console.log('add_numbers(2, 3) =', addNumbers(2, 3));
+
+const maxNative = jit.getFunction('max');
+console.log('max(7, 42) =', maxNative(7, 42));
+
+// Typed pointers accept TypedArrays whose element type matches; the backing
+// store is handed to native code without copying
+const swapNative = jit.getFunction('swap');
+const left = new Int32Array([1]);
+const right = new Int32Array([2]);
+swapNative(left, right);
+console.log('after swap:', left[0], right[0]);
+
+// IR of a handed over module belongs to the engine; its wrappers throw
+try {
+    sumPairFunction.dump();
+} catch (error) {
+    console.log('dump after addModule:', error.message);
+}
+
+// Tiered engines start every function at O0 and recompile the ones that get
+// hot in the background
+const squareFunction = anotherModule.createFunction('square', maxFunctionType);
+builder.setInsertPoint(squareFunction.createBasicBlock('entry'));
+builder.createRet(builder.createMul(squareFunction.getArgument(0), squareFunction.getArgument(1)));
+
+const tieredJit = new llvm.JITEngine({ tiered: true, tierUpThreshold: 100 });
+tieredJit.addModule(anotherModule);
+const squareNative = tieredJit.getFunction('square');
+for (let i = 0; i < 1000; i++) {
+    squareNative(i, i);
+}
+console.log('square tier info:', tieredJit.getTierInfo('square'));
+console.log('tiered JIT stats:', tieredJit.getStats());
+
+// Lazy engines only compile a function the first time it is called, so
+// adding a large module costs next to nothing
+const lazyJitContext = new llvm.LLVMContext();
+const lazyJitInt32 = lazyJitContext.getInt32Ty();
+const lazyJitModule = lazyJitContext.createModule('lazy_module');
+const lazyJitType = llvm.FunctionType.get(lazyJitInt32, [lazyJitInt32], false);
+const lazyJitBuilder = new llvm.IRBuilder(lazyJitContext);
+for (let i = 0; i < 100; i++) {
+    const lazyJitFunction = lazyJitModule.createFunction(`lazy_${i}`, lazyJitType);
+    lazyJitBuilder.setInsertPoint(lazyJitFunction.createBasicBlock('entry'));
+    const lazyJitArg = lazyJitFunction.getArgument(0);
+    lazyJitBuilder.createRet(i % 2 ? lazyJitBuilder.createMul(lazyJitArg, lazyJitArg) : lazyJitBuilder.createAdd(lazyJitArg, lazyJitArg));
+}
+
+const lazyJit = new llvm.JITEngine({ lazy: true });
+lazyJit.addModule(lazyJitModule);
+console.log('lazy_7(6) =', lazyJit.getFunction('lazy_7')(6));
+console.log('lazy JIT compiled', lazyJit.getStats().functionsMaterialized, 'of 100 functions');
+
+
+
+// ==================== Async Demo ====================
+console.log('\n========== Async Demo ==========');
+
+// Async operations run on the libuv thread pool; the context stays locked
+// until the returned Promise settles
+const asyncModule = context.createModule('async_module');
+const cubeFunction = asyncModule.createFunction('cube', maxFunctionType);
+builder.setInsertPoint(cubeFunction.createBasicBlock('entry'));
+const cubeArg = cubeFunction.getArgument(0);
+builder.createRet(builder.createMul(builder.createMul(cubeArg, cubeArg), cubeArg));
+
+const pendingVerify = asyncModule.verifyAsync();
+try {
+    asyncModule.dump();
+} catch (e) {
+    console.log('dump while locked:', e.message);
+}
+console.log('verifyAsync:', await pendingVerify);
+
+await asyncModule.optimizeAsync({ level: 2 });
+const objectFile = await asyncModule.emitObjectAsync();
+console.log('emitObjectAsync produced', objectFile.length, 'bytes');
+
+const asyncJit = new llvm.JITEngine();
+await asyncModule.compileAsync(asyncJit);
+console.log('cube(3, 0) =', asyncJit.getFunction('cube')(3, 0));
+
+
+
+// ==================== Parallel Compile Demo ====================
+console.log('\n========== Parallel Compile Demo ==========');
+
+// Modules only compile in parallel when each one has its own context
+const batchModules = [];
+for (let i = 0; i < 8; i++) {
+    const batchContext = new llvm.LLVMContext();
+    const batchInt32 = batchContext.getInt32Ty();
+    const batchModule = batchContext.createModule(`batch_${i}`);
+    const batchType = llvm.FunctionType.get(batchInt32, [batchInt32], false);
+    const batchFunction = batchModule.createFunction(`twice_${i}`, batchType);
+    const batchBuilder = new llvm.IRBuilder(batchContext);
+    batchBuilder.setInsertPoint(batchFunction.createBasicBlock('entry'));
+    const batchArg = batchFunction.getArgument(0);
+    batchBuilder.createRet(batchBuilder.createAdd(batchArg, batchArg));
+    batchModules.push(batchModule);
+}
+
+// Compiled objects are cached on disk and reused by later runs
+const cacheDir = require('path').join(require('os').tmpdir(), 'llvm_nodejs_cache');
+const parallelJit = new llvm.JITEngine({ compileThreads: 4, cacheDir, cacheMaxBytes: 16 * 1024 * 1024 });
+parallelJit.addModules(batchModules);
+console.log('twice_5(7) =', parallelJit.getFunction('twice_5')(7));
+console.log('parallel JIT stats:', parallelJit.getStats());
+
+
+
+// ==================== Dedupe Demo ====================
+console.log('\n========== Dedupe Demo ==========');
+
+// Functions that only differ in names share one copy of compiled code
+const dedupeJit = new llvm.JITEngine({ dedupe: true });
+for (let i = 0; i < 3; i++) {
+    const tenantContext = new llvm.LLVMContext();
+    const tenantInt32 = tenantContext.getInt32Ty();
+    const tenantModule = tenantContext.createModule(`tenant_${i}`);
+    const tenantType = llvm.FunctionType.get(tenantInt32, [tenantInt32, tenantInt32], false);
+    const tenantFunction = tenantModule.createFunction(`tenant_${i}_mul`, tenantType);
+    const tenantBuilder = new llvm.IRBuilder(tenantContext);
+    tenantBuilder.setInsertPoint(tenantFunction.createBasicBlock(`entry_${i}`));
+    tenantBuilder.createRet(tenantBuilder.createMul(tenantFunction.getArgument(0), tenantFunction.getArgument(1)));
+    dedupeJit.addModule(tenantModule);
+}
+console.log('tenant_2_mul(6, 7) =', dedupeJit.getFunction('tenant_2_mul')(6, 7));
+console.log('dedupe JIT stats:', dedupeJit.getStats());
+
+
+
+// ==================== Unload Demo ====================
+console.log('\n========== Unload Demo ==========');
+
+// Every added module gets its own resource tracker, so its code can be freed
+function buildScaleModule(name, square) {
+    const scaleContext = new llvm.LLVMContext();
+    const scaleInt32 = scaleContext.getInt32Ty();
+    const scaleModule = scaleContext.createModule(`${name}_module`);
+    const scaleType = llvm.FunctionType.get(scaleInt32, [scaleInt32], false);
+    const scaleFunction = scaleModule.createFunction(name, scaleType);
+    const scaleBuilder = new llvm.IRBuilder(scaleContext);
+    scaleBuilder.setInsertPoint(scaleFunction.createBasicBlock('entry'));
+    const scaleArg = scaleFunction.getArgument(0);
+    scaleBuilder.createRet(square ? scaleBuilder.createMul(scaleArg, scaleArg) : scaleBuilder.createAdd(scaleArg, scaleArg));
+    return scaleModule;
+}
+
+const unloadJit = new llvm.JITEngine();
+const scaleHandle = unloadJit.addModule(buildScaleModule('scale', false));
+const scale = unloadJit.getFunction('scale');
+console.log('scale(5) =', scale(5), '- live code bytes:', unloadJit.getStats().liveCodeBytes);
+
+scaleHandle.unload();
+console.log('after unload: loaded =', scaleHandle.isLoaded(), '- live code bytes:', unloadJit.getStats().liveCodeBytes);
+try {
+    scale(5);
+} catch (e) {
+    console.log('calling unloaded function:', e.message);
+}
+
+// The name can be defined again once the old code is gone
+unloadJit.addModule(buildScaleModule('scale', true));
+console.log('redefined scale(5) =', unloadJit.getFunction('scale')(5));
+
+// Without a strong reference from the engine, the code goes away once the
+// module handle and its functions are garbage collected
+if (global.gc) {
+    (() => {
+        unloadJit.addModule(buildScaleModule('scratch', false), { unloadWhenUnreachable: true });
+        console.log('scratch(21) =', unloadJit.getFunction('scratch')(21));
+    })();
+    global.gc();
+    setImmediate(() => {
+        console.log('after GC:', unloadJit.getStats());
+    });
+}
+
+
+
+// ==================== Specialized Calls Demo ====================
+console.log('\n========== Specialized Calls Demo ==========');
+
+// Common signatures such as (i32,i32)->i32 are called through a trampoline
+// compiled for exactly that signature; { specialize: false } forces the
+// generic path (see bench/calls.js for a comparison)
+const maxGeneric = jit.getFunction('max', { specialize: false });
+console.log('max(7, 42) specialized =', maxNative(7, 42), 'generic =', maxGeneric(7, 42));
+
+
+
+// ==================== Batch Demo ====================
+console.log('\n========== Batch Demo ==========');
+
+// fn.map runs a whole column of rows in one native call; batchInlining keeps
+// a copy of small functions so the loop can inline them
+const batchJit = new llvm.JITEngine({ batchInlining: true });
+batchJit.addModule(buildScaleModule('double', false));
+const doubleIt = batchJit.getFunction('double');
+const rows = Int32Array.from({ length: 8 }, (_, i) => i);
+console.log('double.map =', Array.from(doubleIt.map([rows], new Int32Array(rows.length))));
+console.log('max.reduce =', maxNative.reduce([Int32Array.of(3, 17, 9)], -1000));
+
+
+
+// ==================== Worker Sharing Demo ====================
+console.log('\n========== Worker Sharing Demo ==========');
+
+// Workers attach to the engine of the main thread instead of compiling
+// their own copy; the handle is a plain object that postMessage can carry
+const { Worker } = require('worker_threads');
+const addonPath = require.resolve('./build/Release/llvm_nodejs');
+function runInWorker(source, workerData) {
+    return new Promise((resolve, reject) => {
+        const worker = new Worker(`
+            const { parentPort, workerData } = require('worker_threads');
+            const llvm = require(workerData.addon);
+            ${source}
+        `, { eval: true, workerData: { addon: addonPath, ...workerData } });
+        worker.once('message', resolve);
+        worker.once('error', reject);
+    });
+}
+
+const sharedJit = new llvm.JITEngine();
+sharedJit.addModule(buildScaleModule('twice', false));
+const twiceHandle = sharedJit.shareFunction('twice');
+const workerResults = await Promise.all([1, 2, 3].map((n) => runInWorker(`
+    const twice = llvm.JITEngine.importFunction(workerData.handle);
+    parentPort.postMessage(twice(workerData.n));
+`, { handle: twiceHandle, n })));
+console.log('twice() in workers =', workerResults, '- modules compiled:', sharedJit.getStats().modulesAdded);
+
+// A worker can also attach to the whole engine by id and look functions up
+// itself
+const attachToEngine = `
+    try {
+        const engine = llvm.JITEngine.fromShared(workerData.id);
+        parentPort.postMessage('twice(21) = ' + engine.getFunction('twice')(21));
+    } catch (e) {
+        parentPort.postMessage('fromShared failed: ' + e.message);
+    }
+`;
+console.log('engine in worker:', await runInWorker(attachToEngine, { id: sharedJit.share() }));
+
+// The registry only holds engines weakly; once the sharing thread drops its
+// engine, the id no longer attaches
+if (global.gc) {
+    const droppedId = (() => {
+        const droppedJit = new llvm.JITEngine();
+        droppedJit.addModule(buildScaleModule('twice', false));
+        return droppedJit.share();
+    })();
+    global.gc();
+    await new Promise((resolve) => setImmediate(resolve));
+    console.log('dropped engine in worker:', await runInWorker(attachToEngine, { id: droppedId }));
+}
+
+
+
+// ==================== Host Symbols Demo ====================
+console.log('\n========== Host Symbols Demo ==========');
+
+// JIT code calls the JS callback through a native shim; the module only
+// declares `report`, and the engine resolves it when the module is linked
+const hostJit = new llvm.JITEngine();
+const reported = [];
+const reportContext = new llvm.LLVMContext();
+const reportInt32 = reportContext.getInt32Ty();
+const reportType = llvm.FunctionType.get(reportInt32, [reportInt32], false);
+hostJit.defineCallback('report', reportType, (value) => {
+    reported.push(value);
+    return value + 1;
+});
+
+const reportModule = reportContext.createModule('report_module');
+const reportDecl = reportModule.createFunction('report', reportType);
+const reportTwice = reportModule.createFunction('reportTwice', reportType);
+const reportBuilder = new llvm.IRBuilder(reportContext);
+reportBuilder.setInsertPoint(reportTwice.createBasicBlock('entry'));
+const reportFirst = reportBuilder.createCall(reportDecl, [reportTwice.getArgument(0)]);
+reportBuilder.createRet(reportBuilder.createCall(reportDecl, [reportFirst]));
+hostJit.addModule(reportModule);
+
+// loadLibrary() with no path makes the exports of the process (libc, ...)
+// callable by name as well
+hostJit.loadLibrary();
+console.log('reportTwice(10) =', hostJit.getFunction('reportTwice')(10), '- callback saw', reported);
+
+
+
+// ==================== Redefine Demo ====================
+console.log('\n========== Redefine Demo ==========');
+
+// In a redefinable engine every function is called through a stub, so a new
+// body can be swapped in under existing JS handles and JIT callers
+const swapJit = new llvm.JITEngine({ redefinable: true });
+swapJit.addModule(buildScaleModule('step', false));
+const step = swapJit.getFunction('step');
+console.log('step(6) before =', step(6));
+await swapJit.redefine('step', buildScaleModule('step', true));
+console.log('step(6) after  =', step(6));
+
+
+
+// ==================== Optimize Demo ====================
+console.log('\n========== Optimize Demo ==========');
+
+// module.optimize runs the new pass manager pipeline synchronously; levels
+// are 0-3 or 'O0'-'O3', 'Os', 'Oz', and vectorization and unrolling can be
+// switched off to compare code size and compile time
+for (const level of ['O0', 'O2', 'Oz']) {
+    const optModule = buildScaleModule(`opt_${level}`, true);
+    const started = process.hrtime.bigint();
+    optModule.optimize({ level, vectorize: level !== 'Oz', unroll: false });
+    const micros = Number(process.hrtime.bigint() - started) / 1000;
+    console.log(`${level}: ${optModule.dump().length} chars of IR in ${micros.toFixed(0)}us`);
+}
+
+
+
+// ==================== Pass Pipeline Demo ====================
+console.log('\n========== Pass Pipeline Demo ==========');
+
+// Textual pipelines in the syntax of `opt -passes=`, for a whole module or
+// for a single function that changed
+const pipelineContext = new llvm.LLVMContext();
+const pipelineInt32 = pipelineContext.getInt32Ty();
+const pipelineModule = pipelineContext.createModule('pipeline_module');
+const pipelineType = llvm.FunctionType.get(pipelineInt32, [pipelineInt32], false);
+const hotFunction = pipelineModule.createFunction('hot', pipelineType);
+const pipelineBuilder = new llvm.IRBuilder(pipelineContext);
+pipelineBuilder.setInsertPoint(hotFunction.createBasicBlock('entry'));
+const hotArg = hotFunction.getArgument(0);
+pipelineBuilder.createRet(pipelineBuilder.createSub(pipelineBuilder.createAdd(hotArg, hotArg), hotArg));
+
+hotFunction.runPasses('instcombine,gvn');
+console.log(hotFunction.dump().trim());
+pipelineModule.runPasses('function(simplifycfg),globaldce');
+try {
+    pipelineModule.runPasses('function(instcombine');
+} catch (e) {
+    console.log(`${e.code}: ${e.reason} (pipeline '${e.pipeline}')`);
+}
+
+
+
+// ==================== Target Machine Demo ====================
+console.log('\n========== Target Machine Demo ==========');
+
+// detectHost() tunes for the CPU we run on; new TargetMachine() stays on the
+// generic CPU of the process triple. Both take overrides.
+const hostTarget = llvm.TargetMachine.detectHost({ codeModel: 'small', relocModel: 'pic' });
+const genericTarget = new llvm.TargetMachine({ optLevel: 3 });
+console.log(`host: ${hostTarget.getTriple()} cpu=${hostTarget.getCPU()}`);
+console.log(`generic: ${genericTarget.getTriple()} cpu=${genericTarget.getCPU()}`);
+console.log(`data layout: ${hostTarget.getDataLayout()}`);
+
+// setTarget applies the triple and data layout, and later optimization and
+// code generation use this target machine
+const targetedModule = buildScaleModule('targeted', true);
+targetedModule.setTarget(hostTarget);
+targetedModule.optimize('O2');
+const targetedObject = await targetedModule.emitObjectAsync();
+console.log(`emitted ${targetedObject.length} bytes for ${hostTarget.getCPU()}`);
+
+
+
+// ==================== Attributes Demo ====================
+console.log('\n========== Attributes Demo ==========');
+
+// Facts the front-end knows, handed to the optimizer: the swap operands
+// never alias, the helper only reads its arguments, and one call site is
+// forced inline
+const attrContext = new llvm.LLVMContext();
+const attrInt32 = attrContext.getInt32Ty();
+const attrInt32Ptr = llvm.PointerType.get(attrInt32, 0);
+const attrModule = attrContext.createModule('attr_module');
+const attrBuilder = new llvm.IRBuilder(attrContext);
+
+const attrSwap = attrModule.createFunction('swap',
+    llvm.FunctionType.get(attrContext.getVoidTy(), [attrInt32Ptr, attrInt32Ptr], false));
+for (let i = 0; i < 2; i++) {
+    const arg = attrSwap.getArgument(i);
+    arg.addAttribute('noalias');
+    arg.addAttribute('nonnull');
+    arg.addAttribute('align', 4);
+}
+attrSwap.addAttribute('nounwind');
+attrSwap.setMemoryEffects('readwrite', 'argmem');
+attrBuilder.setInsertPoint(attrSwap.createBasicBlock('entry'));
+const attrA = attrBuilder.createLoad(attrInt32, attrSwap.getArgument(0), 'a');
+const attrB = attrBuilder.createLoad(attrInt32, attrSwap.getArgument(1), 'b');
+attrBuilder.createStore(attrB, attrSwap.getArgument(0));
+attrBuilder.createStore(attrA, attrSwap.getArgument(1));
+attrBuilder.createRetVoid();
+
+const attrSum = attrModule.createFunction('sum2',
+    llvm.FunctionType.get(attrInt32, [attrInt32Ptr], false));
+attrSum.getArgument(0).addAttribute('readonly');
+attrSum.setMemoryEffects('read', 'argmem');
+attrSum.addReturnAttribute('noundef');
+attrBuilder.setInsertPoint(attrSum.createBasicBlock('entry'));
+attrBuilder.createRet(attrBuilder.createLoad(attrInt32, attrSum.getArgument(0)));
+
+const attrCaller = attrModule.createFunction('caller',
+    llvm.FunctionType.get(attrInt32, [attrInt32Ptr], false));
+attrBuilder.setInsertPoint(attrCaller.createBasicBlock('entry'));
+const attrCall = attrBuilder.createCall(attrSum, [attrCaller.getArgument(0)]);
+attrCall.addAttribute('alwaysinline');
+attrCall.setTailCall('tail');
+attrBuilder.createRet(attrCall);
+
+console.log('swap:', attrSwap.getAttributes());
+console.log('call site:', attrCall.getAttributes().function);
+try {
+    attrSum.addReturnAttribute('noalias');
+} catch (e) {
+    console.log(`rejected: ${e.message}`);
+}
+console.log('verify:', attrModule.verify().valid);
+
+
+
+// ==================== Loop Hints Demo ====================
+console.log('\n========== Loop Hints Demo ==========');
+
+// double_all(dst, src, n, step): dst[i] = src[i] + src[i] for i < n. The
+// front-end knows the iterations are independent, so the loads and stores
+// go into an access group that the back-edge branch declares parallel.
+const loopContext = new llvm.LLVMContext();
+const loopInt32 = loopContext.getInt32Ty();
+const loopInt32Ptr = llvm.PointerType.get(loopInt32, 0);
+const loopModule = loopContext.createModule('loop_module');
+const loopFunction = loopModule.createFunction('double_all', llvm.FunctionType.get(
+    loopContext.getVoidTy(), [loopInt32Ptr, loopInt32Ptr, loopInt32, loopInt32], false));
+const [loopDst, loopSrc, loopN, loopStep] = [0, 1, 2, 3].map((i) => loopFunction.getArgument(i));
+const loopBuilder = new llvm.IRBuilder(loopContext);
+
+const loopEntry = loopFunction.createBasicBlock('entry');
+const loopBody = loopFunction.createBasicBlock('loop');
+const loopExit = loopFunction.createBasicBlock('exit');
+loopBuilder.setInsertPoint(loopEntry);
+const loopZero = loopBuilder.createSub(loopN, loopN, 'zero');
+loopBuilder.createBr(loopBody);
+
+loopBuilder.setInsertPoint(loopBody);
+const loopIndex = loopBuilder.createPHI(loopInt32, 2, 'i');
+const accessGroup = loopContext.createAccessGroup();
+const loopLoad = loopBuilder.createLoad(loopInt32, loopBuilder.createGEP(loopSrc, [loopIndex]), 'v');
+const loopStore = loopBuilder.createStore(loopBuilder.createAdd(loopLoad, loopLoad), loopBuilder.createGEP(loopDst, [loopIndex]));
+loopLoad.setAccessGroup(accessGroup);
+loopStore.setAccessGroup(accessGroup);
+const loopNext = loopBuilder.createAdd(loopIndex, loopStep, 'next');
+const backEdge = loopBuilder.createCondBr(loopBuilder.createICmpSLT(loopNext, loopN), loopBody, loopExit);
+loopIndex.addIncoming(loopZero, loopEntry);
+loopIndex.addIncoming(loopNext, loopBody);
+loopBuilder.setInsertPoint(loopExit);
+loopBuilder.createRetVoid();
+
+backEdge.setLoopHints({ vectorize: true, vectorizeWidth: 8, interleaveCount: 2, parallelAccesses: [accessGroup] });
+console.log('hints as set:', backEdge.getLoopHints());
+loopModule.optimize('O2');
+console.log('after O2:', loopFunction.getLoopHints());
+
+
+
+// ==================== Profile Demo ====================
+console.log('\n========== Profile Demo ==========');
+
+// rule(x, limit) = x > limit ? x * x : x + x
+function buildRuleModule() {
+    const ruleContext = new llvm.LLVMContext();
+    const ruleInt32 = ruleContext.getInt32Ty();
+    const ruleModule = ruleContext.createModule('rule_module');
+    const ruleFunction = ruleModule.createFunction('rule', llvm.FunctionType.get(ruleInt32, [ruleInt32, ruleInt32], false));
+    const ruleBuilder = new llvm.IRBuilder(ruleContext);
+    const [x, limit] = [ruleFunction.getArgument(0), ruleFunction.getArgument(1)];
+    const ruleEntry = ruleFunction.createBasicBlock('entry');
+    const ruleHigh = ruleFunction.createBasicBlock('high');
+    const ruleLow = ruleFunction.createBasicBlock('low');
+    ruleBuilder.setInsertPoint(ruleEntry);
+    ruleBuilder.createCondBr(ruleBuilder.createICmpSGT(x, limit), ruleHigh, ruleLow);
+    ruleBuilder.setInsertPoint(ruleHigh);
+    ruleBuilder.createRet(ruleBuilder.createMul(x, x));
+    ruleBuilder.setInsertPoint(ruleLow);
+    ruleBuilder.createRet(ruleBuilder.createAdd(x, x));
+    return ruleModule;
+}
+
+// Collect edge counts from real traffic in an instrumented engine...
+const profilingJit = new llvm.JITEngine({ instrument: true });
+profilingJit.addModule(buildRuleModule());
+const profiledRule = profilingJit.getFunction('rule');
+for (let i = 0; i < 1000; i++) {
+    profiledRule(i % 10, 8);
+}
+const ruleProfile = profilingJit.getProfile();
+console.log('profile:', JSON.stringify(ruleProfile));
+
+// ...then rebuild the module without counters and optimize it by them
+const tunedModule = buildRuleModule();
+tunedModule.applyProfile(ruleProfile);
+tunedModule.optimize('O2');
+console.log(tunedModule.dump().split('\n').filter((line) => line.includes('branch_weights') || line.includes('entry_count')).join('\n'));
+
+
+
+// ==================== Linking Demo ====================
+console.log('\n========== Linking Demo ==========');
+
+// Helpers kept in a separate module (in practice C compiled with
+// `clang -c -emit-llvm runtime.c`) are linked into generated code and
+// internalized, so the optimizer inlines them and drops the unused ones
+const linkContext = new llvm.LLVMContext();
+const linkInt32 = linkContext.getInt32Ty();
+const linkUnary = llvm.FunctionType.get(linkInt32, [linkInt32], false);
+const linkBuilder = new llvm.IRBuilder(linkContext);
+
+const runtimeModule = linkContext.createModule('runtime');
+for (const [name, square] of [['rt_square', true], ['rt_double', false]]) {
+    const helper = runtimeModule.createFunction(name, linkUnary);
+    linkBuilder.setInsertPoint(helper.createBasicBlock('entry'));
+    const helperArg = helper.getArgument(0);
+    linkBuilder.createRet(square ? linkBuilder.createMul(helperArg, helperArg) : linkBuilder.createAdd(helperArg, helperArg));
+}
+
+const appModule = linkContext.createModule('app');
+const rtSquare = appModule.createFunction('rt_square', linkUnary);
+const appMain = appModule.createFunction('app_main', linkUnary);
+linkBuilder.setInsertPoint(appMain.createBasicBlock('entry'));
+linkBuilder.createRet(linkBuilder.createCall(rtSquare, [appMain.getArgument(0)]));
+
+appModule.link(runtimeModule, { onlyNeeded: true, internalize: true });
+appModule.optimize('O2');
+console.log(appModule.dump());
+
+// A prebuilt runtime library is parsed once per context and linked the
+// same way
+const runtimePath = require('path').join(process.cwd(), 'runtime.bc');
+if (require('fs').existsSync(runtimePath)) {
+    const runtime = linkContext.loadBitcodeLibrary(runtimePath);
+    console.log('runtime.bc exports:', runtime.getFunctionNames().join(', '));
+}
+
+
+
+// ==================== Code Emission Demo ====================
+console.log('\n========== Code Emission Demo ==========');
+
+// Object files and assembly come straight from the target machine instead
+// of piping dump() through llc
+const emitContext = new llvm.LLVMContext();
+const emitInt32 = emitContext.getInt32Ty();
+const emitUnary = llvm.FunctionType.get(emitInt32, [emitInt32], false);
+const emitBuilder = new llvm.IRBuilder(emitContext);
+const emitModule = emitContext.createModule('emit');
+for (let i = 0; i < 8; i++) {
+    const fn = emitModule.createFunction(`emit_${i}`, emitUnary);
+    emitBuilder.setInsertPoint(fn.createBasicBlock('entry'));
+    const emitArg = fn.getArgument(0);
+    emitBuilder.createRet(i % 2 ? emitBuilder.createMul(emitArg, emitArg) : emitBuilder.createAdd(emitArg, emitArg));
+}
+
+const emittedObject = emitModule.emitObject();
+console.log('emitObject produced', emittedObject.length, 'bytes');
+console.log(emitModule.emitAssembly().toString().split('\n').slice(0, 8).join('\n'));
+
+// Large modules can be split and compiled on several threads; the parts
+// link together (e.g. `ld -r`) into the same code as a single object
+const objectParts = emitModule.emitObject({ threads: 4 });
+console.log('split emitObject produced', objectParts.map((part) => part.length).join(' + '), 'bytes');
+const assemblyParts = await emitModule.emitAssemblyAsync({ threads: 2 });
+console.log('emitAssemblyAsync produced', assemblyParts.length, 'listings');
+
+
+
+// ==================== Bitcode Demo ====================
+console.log('\n========== Bitcode Demo ==========');
+
+// Bitcode is smaller and much faster to read back than textual IR, which
+// makes it the format for caching modules or sending them to workers
+const bitcode = emitModule.toBitcode();
+console.log('toBitcode produced', bitcode.length, 'bytes, dump()', Buffer.byteLength(emitModule.dump()), 'bytes');
+const bitcodeContext = new llvm.LLVMContext();
+const reloaded = bitcodeContext.parseBitcode(bitcode);
+console.log('parseBitcode round trip matches:', reloaded.dump() === emitModule.dump());
+console.log('parseIR round trip matches:', bitcodeContext.parseIR(emitModule.dump()).dump() === emitModule.dump());
+
+
+
+// ==================== Streaming Print Demo ====================
+console.log('\n========== Streaming Print Demo ==========');
+
+// printTo streams IR in fixed-size chunks instead of building one string,
+// so modules larger than V8's string limit can still be written out
+const printedChunks = [];
+emitModule.printTo((chunk) => printedChunks.push(chunk), { chunkSize: 256 });
+console.log('printTo produced', printedChunks.length, 'chunks, matches dump():',
+    Buffer.concat(printedChunks).toString() === emitModule.dump());
+
+const irPath = require('path').join(require('os').tmpdir(), 'llvm_nodejs_emit.ll');
+const irFd = require('fs').openSync(irPath, 'w');
+emitModule.printTo(irFd);
+require('fs').closeSync(irFd);
+console.log('printTo(fd) wrote', require('fs').statSync(irPath).size, 'bytes to', irPath);
+
+
+
+// ==================== Lazy Bitcode Demo ====================
+console.log('\n========== Lazy Bitcode Demo ==========');
+
+// A lazily loaded library is memory-mapped and only its declarations are
+// read; linking reads the bodies of the functions a module actually calls
+const libraryPath = require('path').join(require('os').tmpdir(), 'llvm_nodejs_runtime.bc');
+require('fs').writeFileSync(libraryPath, runtimeModule.toBitcode());
+const lazyContext = new llvm.LLVMContext();
+const lazyRuntime = lazyContext.loadBitcodeLazy(libraryPath);
+console.log('lazy library exports:', lazyRuntime.getFunctionNames().join(', '));
+
+const lazyInt32 = lazyContext.getInt32Ty();
+const lazyUnary = llvm.FunctionType.get(lazyInt32, [lazyInt32], false);
+const lazyApp = lazyContext.createModule('lazy_app');
+const lazySquare = lazyApp.createFunction('rt_square', lazyUnary);
+const lazyMain = lazyApp.createFunction('lazy_main', lazyUnary);
+const lazyBuilder = new llvm.IRBuilder(lazyContext);
+lazyBuilder.setInsertPoint(lazyMain.createBasicBlock('entry'));
+lazyBuilder.createRet(lazyBuilder.createCall(lazySquare, [lazyMain.getArgument(0)]));
+lazyApp.link(lazyRuntime);
+console.log(lazyApp.dump());